@@ -0,0 +1,73 @@
+#include "block_reader.h"
+
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#ifndef WINDOWS
+#include <cerrno>
+#include <unistd.h>
+
+BlockReader::BlockReader(int fd, size_t block_size): fd(fd), buffer(block_size) {}
+#endif
+
+BlockReader::BlockReader(std::istream& input, size_t block_size): input(&input), buffer(block_size) {}
+
+bool BlockReader::next(std::string_view& lines) {
+    // move the partial line we didn't hand out last time to the front
+    size_t leftover = filled - consumed;
+    if (leftover > 0 && consumed > 0) std::memmove(buffer.data(), buffer.data() + consumed, leftover);
+    filled = leftover;
+    consumed = 0;
+
+    size_t searched = 0;
+    while (true) {
+        // look for the last newline in the part of the buffer we haven't searched yet
+        for (size_t i = filled; i > searched; i--) {
+            if (buffer[i - 1] == '\n') {
+                consumed = i;
+                break;
+            }
+        }
+        if (consumed > 0) break;
+        searched = filled;
+
+        if (eof) {
+            // the last line doesn't have to end in a newline
+            if (filled == 0) return false;
+            consumed = filled;
+            break;
+        }
+
+        // one line longer than the whole buffer, so make room for it
+        if (filled == buffer.size()) buffer.resize(buffer.size() * 2);
+        fill();
+    }
+
+    lines = std::string_view(buffer.data(), consumed);
+    return true;
+}
+
+void BlockReader::fill() {
+#ifndef WINDOWS
+    if (fd >= 0) {
+        // one read fills the rest of the buffer from a file, and only waits for a pipe or a terminal to have
+        // something, rather than for a whole block of it (which could be never, with a pipe that's waiting on us)
+        ssize_t got;
+        do {
+            got = ::read(fd, buffer.data() + filled, buffer.size() - filled);
+        } while (got < 0 && errno == EINTR);
+        if (got < 0) throw std::runtime_error(std::string("couldn't read input (") + std::strerror(errno) + ")");
+        if (got == 0) eof = true;
+        filled += got;
+        return;
+    }
+#endif
+    // without an fd the best we can do is wait for one byte and then take whatever the stream already has
+    if (!input->read(buffer.data() + filled, 1)) {
+        eof = true;
+        return;
+    }
+    filled++;
+    filled += input->readsome(buffer.data() + filled, buffer.size() - filled);
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <istream>
+#include <string_view>
+#include <vector>
+
+// Reads a stream in big blocks instead of a line at a time.
+// Each call hands back a view of whole lines straight out of the buffer (no per-line strings),
+// and whatever partial line is left at the end of a block gets carried over to the next one.
+// It only waits for as much as it needs to finish a line, so lines from a pipe come out as they're written.
+class BlockReader {
+public:
+#ifndef WINDOWS
+    // read fd straight into the buffer, a block at a time from a file and whatever has been written from a pipe
+    // (the fd still belongs to the caller). next throws std::runtime_error if it can't be read
+    explicit BlockReader(int fd, size_t block_size = DEFAULT_BLOCK_SIZE);
+#endif
+    // for input there's no fd for, which goes through the stream's own buffer
+    explicit BlockReader(std::istream& input, size_t block_size = DEFAULT_BLOCK_SIZE);
+    ~BlockReader() = default;
+
+    static constexpr size_t DEFAULT_BLOCK_SIZE = 1 << 20;
+
+    // sets lines to the next run of complete lines (ending just after a '\n', or at the end of the input)
+    // returns false once there's nothing left. the view is only valid until the next call
+    bool next(std::string_view& lines);
+
+private:
+    std::istream* input = nullptr;
+    int fd = -1;
+    std::vector<char> buffer;
+    // buffer[0, filled) holds data, of which [consumed, filled) hasn't been handed out yet
+    size_t filled = 0;
+    size_t consumed = 0;
+    bool eof = false;
+
+    void fill();
+};
@@ -0,0 +1,21 @@
+#include "dfa_file.h"
+
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+DFAFile::DFAFile(const std::string& path): mapped(path) {
+    if (mapped.is_open()) return;
+
+    std::ifstream file(path, std::ios::binary);
+    if (!file) throw std::runtime_error("couldn't open dfa file for reading: " + path);
+    // a heap allocated string is aligned enough for the table to be used in place
+    buffer.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+void write_dfa_file(const std::string& path, const std::string& bytes) {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file) throw std::runtime_error("couldn't open dfa file for writing: " + path);
+    file.write(bytes.data(), bytes.size());
+    if (!file) throw std::runtime_error("couldn't write dfa file: " + path);
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+#include "mapped_file.h"
+
+// The bytes of a file written by --save-dfa, kept around for as long as the dfa is using them.
+// It's memory mapped when it can be, so loading a saved pattern is just the mmap, otherwise it's read into memory.
+// throws std::runtime_error if the file can't be read
+class DFAFile {
+public:
+    explicit DFAFile(const std::string& path);
+    ~DFAFile() = default;
+
+    DFAFile(const DFAFile&) = delete;
+    DFAFile& operator=(const DFAFile&) = delete;
+
+    std::string_view contents() const { return mapped.is_open() ? mapped.contents() : std::string_view(buffer); }
+
+private:
+    MappedFile mapped;
+    std::string buffer;
+};
+
+// write the bytes from Regex::save_dfa to path, throws std::runtime_error if it can't
+void write_dfa_file(const std::string& path, const std::string& bytes);
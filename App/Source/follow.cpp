@@ -0,0 +1,149 @@
+#include "follow.h"
+
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#ifndef WINDOWS
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#ifdef __linux__
+#include <sys/inotify.h>
+#else
+#include <chrono>
+#include <thread>
+#endif
+
+#include "../../Core/Source/Core/matcher.h"
+#include "../../Core/Source/Core/stream_matcher.h"
+#include "search.h"
+
+using std::string;
+
+#ifndef WINDOWS
+namespace {
+    // how much of a file gets read at once
+    constexpr size_t READ_SIZE = 64 * 1024;
+#ifndef __linux__
+    // without inotify, how long to wait before looking at the files again
+    constexpr auto POLL_INTERVAL = std::chrono::milliseconds(250);
+#endif
+
+    // a file we're following, read up to stream.offset()
+    struct FollowedFile {
+        string path;
+        int fd;
+        int watch = -1;
+        StreamMatcher stream;
+        // the bytes of the line we're in the middle of, for printing it if it turns out to match
+        string partial;
+
+        FollowedFile(const string& path, int fd, const Regex& regex): path(path), fd(fd), stream(regex) {}
+        ~FollowedFile() { ::close(fd); }
+
+        FollowedFile(const FollowedFile&) = delete;
+        FollowedFile& operator=(const FollowedFile&) = delete;
+    };
+
+    // read whatever has been added to file since we last looked, and print the lines in it that match
+    void read_new(FollowedFile& file, vector<char>& buffer, Matcher& matcher, Output& out, const Options& options) {
+        // shorter than what we've read means it's been truncated (or rewritten), so start it again
+        struct stat info;
+        if (fstat(file.fd, &info) == 0 && static_cast<uint64_t>(info.st_size) < file.stream.offset()) {
+            lseek(file.fd, 0, SEEK_SET);
+            file.stream.reset();
+            file.partial.clear();
+        }
+
+        while (true) {
+            ssize_t got = ::read(file.fd, buffer.data(), buffer.size());
+            if (got < 0 && errno == EINTR) continue;
+            if (got <= 0) break;
+            std::string_view chunk(buffer.data(), got);
+            file.stream.feed(chunk.data(), chunk.size(), [&](const LineMatch& match) {
+                if (match.complete()) {
+                    print_line(out, match.text, match.start, file.path, matcher, options);
+                    return;
+                }
+                // it started in an earlier chunk, so this is the only time a line gets copied
+                string line = file.partial;
+                line.append(match.text);
+                print_line(out, line, match.start, file.path, matcher, options);
+            });
+            size_t last_newline = chunk.rfind('\n');
+            if (last_newline == std::string_view::npos) file.partial.append(chunk);
+            else file.partial.assign(chunk.substr(last_newline + 1));
+        }
+        // someone is watching for these, so they go out now rather than when the buffer fills up
+        out.flush();
+    }
+}
+#endif
+
+int follow_files(const Options& options, const Regex& regex, Output& out) {
+#ifdef WINDOWS
+    std::cerr << "--follow isn't supported on Windows yet" << std::endl;
+    return 2;
+#else
+    // only for print_line, which wants spans and pattern ids for the lines that match
+    Matcher matcher(regex);
+
+#ifdef __linux__
+    int notify = inotify_init1(IN_CLOEXEC);
+    if (notify < 0) throw std::runtime_error("couldn't start watching the files (inotify_init1 failed)");
+#endif
+
+    vector<std::unique_ptr<FollowedFile>> files;
+    for (const string& path : options.files) {
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            std::cerr << "couldn't open file for reading: " << path << std::endl;
+            continue;
+        }
+        // reading a pipe that's gone quiet would block, and then the other files wouldn't get looked at
+        struct stat info;
+        if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode)) {
+            std::cerr << "can only follow regular files: " << path << std::endl;
+            ::close(fd);
+            continue;
+        }
+        files.push_back(std::make_unique<FollowedFile>(path, fd, regex));
+#ifdef __linux__
+        // watch it before reading it, so nothing written in between gets missed
+        files.back()->watch = inotify_add_watch(notify, path.c_str(), IN_MODIFY);
+        if (files.back()->watch < 0) throw std::runtime_error("couldn't watch file: " + path);
+#endif
+    }
+    if (files.empty()) return 2;
+
+    vector<char> buffer(READ_SIZE);
+    for (auto& file : files) read_new(*file, buffer, matcher, out, options);
+
+    while (true) {
+#ifdef __linux__
+        // blocks until one of the files changes
+        alignas(inotify_event) char events[4096];
+        ssize_t got = ::read(notify, events, sizeof(events));
+        if (got < 0) {
+            if (errno == EINTR) continue;
+            throw std::runtime_error("couldn't read file events from inotify");
+        }
+        for (ssize_t i = 0; i < got;) {
+            const inotify_event* event = reinterpret_cast<const inotify_event*>(events + i);
+            for (auto& file : files) {
+                if (file->watch == event->wd) read_new(*file, buffer, matcher, out, options);
+            }
+            i += sizeof(inotify_event) + event->len;
+        }
+#else
+        std::this_thread::sleep_for(POLL_INTERVAL);
+        for (auto& file : files) read_new(*file, buffer, matcher, out, options);
+#endif
+    }
+#endif
+}
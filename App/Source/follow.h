@@ -0,0 +1,13 @@
+#pragma once
+
+#include "../../Core/Source/Core/regex.h"
+#include "options.h"
+#include "output.h"
+
+// --follow: search each file to the end, then keep printing the matching lines that get added to them, like
+// tail -f but only the lines that match. Every file gets a StreamMatcher, so what was already there is never
+// searched again, and a line written in several goes gets matched as it comes in. On Linux inotify wakes us up
+// when a file changes, elsewhere we look every so often. A file that gets truncated is searched again from the start.
+// Only returns (with 2) if none of the files could be followed, otherwise it runs until it's killed.
+// throws std::runtime_error if the files can't be watched
+int follow_files(const Options& options, const Regex& regex, Output& out);
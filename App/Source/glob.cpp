@@ -0,0 +1,82 @@
+#include "glob.h"
+
+namespace {
+    // matches the [...] set starting at pattern[i] against ch, and sets i to just after the ]
+    // returns false without moving i if the set is never closed, so the [ gets treated as a literal
+    bool match_set(std::string_view pattern, size_t& i, char ch, bool& matched) {
+        size_t j = i + 1;
+        bool negate = j < pattern.size() && (pattern[j] == '!' || pattern[j] == '^');
+        if (negate) j++;
+
+        bool in_set = false;
+        bool first = true;
+        for (; j < pattern.size(); j++) {
+            // a ] straight after the [ is part of the set
+            if (pattern[j] == ']' && !first) {
+                matched = in_set != negate;
+                i = j + 1;
+                return true;
+            }
+            first = false;
+            if (j + 2 < pattern.size() && pattern[j + 1] == '-' && pattern[j + 2] != ']') {
+                if (pattern[j] <= ch && ch <= pattern[j + 2]) in_set = true;
+                j += 2;
+            }
+            else if (pattern[j] == ch) {
+                in_set = true;
+            }
+        }
+        return false;
+    }
+}
+
+bool glob_match(std::string_view pattern, std::string_view name) {
+    // greedy matching that backtracks to the last * when it gets stuck
+    size_t p = 0, n = 0;
+    size_t star = std::string_view::npos, star_n = 0;
+
+    while (n < name.size()) {
+        if (p < pattern.size()) {
+            char pc = pattern[p];
+            if (pc == '*') {
+                star = p++;
+                star_n = n;
+                continue;
+            }
+            if (pc == '?') {
+                p++;
+                n++;
+                continue;
+            }
+            if (pc == '[') {
+                size_t after = p;
+                bool matched = false;
+                if (match_set(pattern, after, name[n], matched)) {
+                    if (matched) {
+                        p = after;
+                        n++;
+                        continue;
+                    }
+                }
+                else if (name[n] == '[') {
+                    p++;
+                    n++;
+                    continue;
+                }
+            }
+            else if (pc == name[n]) {
+                p++;
+                n++;
+                continue;
+            }
+        }
+        // mismatch, let the last * eat one more character
+        if (star == std::string_view::npos) return false;
+        p = star + 1;
+        n = ++star_n;
+    }
+
+    // whatever's left of the pattern has to be stars
+    while (p < pattern.size() && pattern[p] == '*') p++;
+    return p == pattern.size();
+}
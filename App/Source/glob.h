@@ -0,0 +1,7 @@
+#pragma once
+
+#include <string_view>
+
+// shell style wildcard match of name against pattern: * matches any run of characters, ? matches one,
+// and [abc] / [a-z] / [!abc] match one character from (or not from) the set
+bool glob_match(std::string_view pattern, std::string_view name);
@@ -1,87 +1,83 @@
+#include <chrono>
 #include <iostream>
-#include <fstream>
+#include <memory>
+#include <stdexcept>
 #include <string>
-#include "../../Core/Source/Core/nfa.h"
-#include "../../Core/Source/Core/regex_compiler.h"
-#include "../../Core/Source/Core/token.h"
+#include "../../Core/Source/Core/matcher.h"
+#include "../../Core/Source/Core/regex.h"
+#include "dfa_file.h"
+#include "follow.h"
+#include "options.h"
+#include "output.h"
+#include "search.h"
+#include "stats_report.h"
 
 //throw std::runtime_error("Unhandled pattern " + pattern);
 
-bool run_nfa(std::istream* input, NFA &nfa, bool found, string filename = "") {
-    // loop through the file looking for the regex
-    std::string input_line;
-    while (std::getline(*input, input_line)) {
-        if (nfa.run(input_line)) {
-            if (filename != "") {
-                std::cout << filename << ": " << input_line << std::endl;
-            } else {
-                std::cout << input_line << std::endl;
-            }
-            found = true;
-        }
-    }
-    return found;
-}
-
 int main(int argc, char* argv[]) {
-    // Flush after every std::cout / std::cerr
-    std::cout << std::unitbuf;
+    // errors go out straight away, matches go through an Output so they get written in big blocks
     std::cerr << std::unitbuf;
+    // stdin is only read in big blocks (and not through std::cin at all, outside Windows), so it doesn't need to stay in sync with stdio
+    std::ios::sync_with_stdio(false);
 
     // You can use print statements as follows for debugging, they'll be visible when running tests.
     // std::cerr << "Logs from your program will appear here" << std::endl;
-    if (argc < 3) {
-        std::cerr << "Expected at least three arguments: -E <regex> [file]" << std::endl;
-        return 2;
-    }
-
-	// the tutorial had me create a flag for -E
-	// if you don't add any other flags then get rid of the flag
-    std::string flag = argv[1];
-	// this is currently the regex expression to search for
-    std::string pattern = argv[2];
-
-    // do i really need this? I don't think I need a flag
-    if (flag != "-E") {
-        std::cerr << "Expected first argument to be '-E'" << std::endl;
+    Options options;
+    if (!parse_options(argc, argv, options)) {
         return 2;
     }
 
     try {
         // create nfa here
         // don't need a parser and a compiler, it's a waste just have one engine to create the nfa
-        RegexCompiler compiler;
-        vector<Token> tokens = compiler.parse(pattern);
-        NFA nfa = compiler.compile(tokens);
-
+        // (Regex also builds whichever faster engines suit the patterns, and Matcher picks between them)
+        // a saved dfa gets mapped straight in, and has to stay mapped for as long as we're matching
+        std::unique_ptr<DFAFile> dfa_file;
+        if (!options.load_dfa.empty()) dfa_file = std::make_unique<DFAFile>(options.load_dfa);
+        Regex regex = dfa_file ? Regex::load_dfa(dfa_file->contents()) : Regex(options.patterns, needs_spans(options));
+
+        if (!options.save_dfa.empty()) {
+            write_dfa_file(options.save_dfa, regex.save_dfa());
+            return 0;
+        }
 
+        // anyone watching a terminal wants to see each line as soon as it's found
+        Output out(1, options.line_buffered || is_terminal(1));
+        const auto search_start = std::chrono::steady_clock::now();
+        auto report = [&](const MatchStats& stats) {
+            if (!options.stats) return;
+            double search_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - search_start).count();
+            print_stats(std::cerr, regex, stats, search_seconds, out.seconds_writing());
+        };
+
+        // this only comes back if there was nothing it could follow
+        if (options.follow) return follow_files(options, regex, out);
+
+        // several jobs (or directories to walk), so share the compiled patterns between threads
+        if ((options.jobs > 1 && !options.files.empty()) || options.recursive) {
+            MatchStats stats;
+            int status = search_files_parallel(options, regex, out, stats);
+            out.flush();
+            report(stats);
+            if (status == 1) std::cout << "No matches found" << std::endl;
+            return status;
+        }
 
-        // accept both file input stream and cin input stream by making the input a pointer to an istream
-        std::istream* input;
-        std::ifstream ifs;
+        // the dfa gets built lazily as we match, and falls back to the nfa if it gets too big
+        Matcher matcher(regex);
+        matcher.collect_stats(options.stats);
 
         bool found = false;
-        if (argc > 3) {
-
-            for (int i = 3; i < argc; i++) {
-                // make a helper function that runs the nfa 
-                // input filepath
-                std::string input_file = argv[i];
-                ifs.open(input_file);
-                if (!ifs) {
-                    throw std::runtime_error("couldn't open file for reading: " + input_file);
-                    return 2;
-                }
-                input = &ifs;
-                found = run_nfa(input, nfa, found, input_file);
-                ifs.close();
-                ifs.clear();
+        if (!options.files.empty()) {
+            for (const std::string& input_file : options.files) {
+                found = search_file(input_file, matcher, out, options) || found;
             }
-        } else if (argc == 3) {
+        } else {
             // we have an input stirng
-            input = &std::cin;
-            found = run_nfa(input, nfa, found);
+            found = search_stdin(matcher, out, options);
         }
+        out.flush();
+        report(matcher.stats());
 
 
         if (found) {
@@ -93,7 +89,9 @@ int main(int argc, char* argv[]) {
     } catch (const std::runtime_error& e) {
         std::cerr << e.what() << std::endl;
         return 2;
+    } catch (const std::logic_error& e) {
+        // the compiler throws these for patterns it can't make sense of
+        std::cerr << "invalid pattern: " << e.what() << std::endl;
+        return 2;
     }
 }
-
-
@@ -0,0 +1,43 @@
+#include "mapped_file.h"
+
+#ifndef WINDOWS
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile(const std::string& path) {
+#ifndef WINDOWS
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return;
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode)) {
+        ::close(fd);
+        return;
+    }
+
+    size = info.st_size;
+    if (size > 0) {
+        void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping == MAP_FAILED) {
+            ::close(fd);
+            size = 0;
+            return;
+        }
+        // we read it front to back once, so ask the kernel to read ahead aggressively
+        madvise(mapping, size, MADV_SEQUENTIAL);
+        data = static_cast<const char*>(mapping);
+    }
+    // the mapping stays valid after the file is closed
+    ::close(fd);
+    open = true;
+#endif
+}
+
+MappedFile::~MappedFile() {
+#ifndef WINDOWS
+    if (data != nullptr) munmap(const_cast<char*>(data), size);
+#endif
+}
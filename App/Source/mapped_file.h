@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+// Read only memory map of a regular file, so we can match straight out of the page cache with no copies.
+// Anything that can't be mapped (pipes, devices, missing files, or Windows for now) leaves is_open() false
+// and the caller should stream it with a BlockReader instead.
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool is_open() const { return open; }
+    std::string_view contents() const { return {data, size}; }
+
+private:
+    const char* data = nullptr;
+    size_t size = 0;
+    bool open = false;
+};
@@ -0,0 +1,142 @@
+#include "options.h"
+
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+
+namespace {
+    // -j past this is refused
+    constexpr unsigned long MAX_JOBS = 1024;
+    const char* USAGE = "usage: grape (-E <regex> | -e <regex>... | -f <file> | --load-dfa <file>) [--save-dfa <file>] [--pattern-ids] [-o] [--color] [--groups] [-b] [--line-buffered] [--stats] [--follow] [-j N] [--unordered] [-r [--include GLOB] [--exclude GLOB] [--exclude-dir GLOB]] [file...]";
+
+    bool parse_jobs(const std::string& value, unsigned& jobs) {
+        if (value.empty() || value.find_first_not_of("0123456789") != std::string::npos) return false;
+        unsigned long n;
+        try {
+            n = std::stoul(value);
+        }
+        catch (const std::invalid_argument&) {
+            return false;
+        }
+        catch (const std::out_of_range&) {
+            return false;
+        }
+        // every job is a thread, so anything past this is a typo rather than a machine
+        if (n > MAX_JOBS) return false;
+        // -j 0 means one job per core
+        if (n == 0) n = std::max(1u, std::thread::hardware_concurrency());
+        jobs = static_cast<unsigned>(n);
+        return true;
+    }
+
+    // every non empty line of the file is a pattern
+    bool read_patterns(const std::string& path, std::vector<std::string>& patterns) {
+        std::ifstream file(path);
+        if (!file) return false;
+        std::string line;
+        while (std::getline(file, line)) {
+            if (!line.empty() && line.back() == '\r') line.pop_back();
+            if (!line.empty()) patterns.push_back(line);
+        }
+        return true;
+    }
+}
+
+bool parse_options(int argc, char* argv[], Options& options) {
+    if (argc < 3) {
+        std::cerr << "Expected at least three arguments: -E <regex> [file]" << std::endl;
+        std::cerr << USAGE << std::endl;
+        return false;
+    }
+
+    bool have_pattern = false;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+
+        // flags that take a value
+        if (arg == "-E" || arg == "-e" || arg == "-f" || arg == "-j" || arg == "--include" || arg == "--exclude" || arg == "--exclude-dir"
+            || arg == "--save-dfa" || arg == "--load-dfa") {
+            if (i + 1 >= argc) {
+                std::cerr << "Expected a value after '" << arg << "'" << std::endl;
+                return false;
+            }
+            std::string value = argv[++i];
+            if (arg == "-E" || arg == "-e") {
+                options.patterns.push_back(value);
+                have_pattern = true;
+            }
+            else if (arg == "-f") {
+                if (!read_patterns(value, options.patterns)) {
+                    std::cerr << "couldn't open pattern file for reading: " << value << std::endl;
+                    return false;
+                }
+                have_pattern = true;
+            }
+            else if (arg == "-j") {
+                if (!parse_jobs(value, options.jobs)) {
+                    std::cerr << "Expected a number of jobs (0 to " << MAX_JOBS << ") after '-j', got '" << value << "'" << std::endl;
+                    return false;
+                }
+            }
+            else if (arg == "--save-dfa") options.save_dfa = value;
+            else if (arg == "--load-dfa") options.load_dfa = value;
+            else if (arg == "--include") options.include.push_back(value);
+            else if (arg == "--exclude") options.exclude.push_back(value);
+            else options.exclude_dir.push_back(value);
+        }
+        else if (arg == "--pattern-ids") {
+            options.pattern_ids = true;
+        }
+        else if (arg == "-o") {
+            options.only_matching = true;
+        }
+        else if (arg == "--color") {
+            options.color = true;
+        }
+        else if (arg == "--groups") {
+            options.groups = true;
+        }
+        else if (arg == "-b") {
+            options.byte_offset = true;
+        }
+        else if (arg == "--line-buffered") {
+            options.line_buffered = true;
+        }
+        else if (arg == "--stats") {
+            options.stats = true;
+        }
+        else if (arg == "--follow") {
+            options.follow = true;
+        }
+        else if (arg == "--unordered") {
+            options.unordered = true;
+        }
+        else if (arg == "-r") {
+            options.recursive = true;
+        }
+        else {
+            options.files.push_back(arg);
+        }
+    }
+
+    if (!options.load_dfa.empty()) {
+        // the saved dfa is the pattern, and it doesn't know which of the original patterns matched (or where)
+        if (have_pattern || !options.save_dfa.empty() || options.pattern_ids || needs_spans(options)) {
+            std::cerr << "--load-dfa can't be used with patterns, --save-dfa, --pattern-ids, -o, --color or --groups" << std::endl;
+            return false;
+        }
+    }
+    else if (!have_pattern || options.patterns.empty()) {
+        std::cerr << "Expected a pattern: -E <regex>" << std::endl;
+        std::cerr << USAGE << std::endl;
+        return false;
+    }
+    if (options.follow && (options.files.empty() || options.recursive || !options.save_dfa.empty())) {
+        std::cerr << "--follow needs files to follow, and can't be used with -r or --save-dfa" << std::endl;
+        return false;
+    }
+    // like grep, a recursive search with nothing to search means the current directory
+    if (options.recursive && options.files.empty()) options.files.push_back(".");
+    return true;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// everything we got on the command line
+struct Options {
+    // the regex expressions to search for (-E/-e, and -f files), a line matches if any of them does
+    std::vector<std::string> patterns;
+    // print which patterns (by index) matched each line
+    bool pattern_ids = false;
+    // print each match on its own line instead of the whole line
+    bool only_matching = false;
+    // highlight the matches
+    bool color = false;
+    // print the capture groups of each match (tab separated) instead of the line
+    bool groups = false;
+    // write every line out as soon as it's found, instead of in big blocks (it always is to a terminal)
+    bool line_buffered = false;
+    // print the byte offset in the file of each line (or of each match, with only_matching)
+    bool byte_offset = false;
+    // print where the time went and what the matcher did to stderr once we're done
+    bool stats = false;
+    // search the files, then keep printing the matching lines that get added to them until we're killed
+    bool follow = false;
+    // build the whole dfa for the patterns, write it to this file and exit
+    std::string save_dfa;
+    // search with a dfa saved by --save-dfa instead of patterns
+    std::string load_dfa;
+    // files to search, read std::cin if there aren't any
+    std::vector<std::string> files;
+    // how many files to search at once
+    unsigned jobs = 1;
+    // print each file's results as soon as it's done instead of in argument order
+    bool unordered = false;
+
+    // search directories (and everything under them)
+    bool recursive = false;
+    // while walking directories, only search files whose names match one of these (if there are any)
+    std::vector<std::string> include;
+    // while walking directories, skip files and directories whose names match one of these
+    std::vector<std::string> exclude;
+    std::vector<std::string> exclude_dir;
+};
+
+// fills in options from argv, prints what's wrong and returns false if it doesn't make sense
+bool parse_options(int argc, char* argv[], Options& options);
+
+// true if the output needs to know where in a line the matches are, not just which lines match
+inline bool needs_spans(const Options& options) { return options.only_matching || options.color || options.groups; }
@@ -0,0 +1,106 @@
+#include "output.h"
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+
+#ifndef WINDOWS
+#include <climits>
+#include <sys/uio.h>
+#include <unistd.h>
+#else
+#include <cstdio>
+#include <io.h>
+#endif
+
+namespace {
+    [[noreturn]] void write_failed() {
+        throw std::runtime_error(string("couldn't write output: ") + std::strerror(errno));
+    }
+
+#ifndef WINDOWS
+    // writev everything in pieces, picking up where a short write left off
+    void write_pieces(int fd, std::vector<std::string_view> pieces) {
+        std::vector<iovec> vectors;
+        size_t first = 0;
+        while (first < pieces.size()) {
+            vectors.clear();
+            for (size_t i = first; i < pieces.size() && vectors.size() < IOV_MAX; i++) {
+                if (pieces[i].empty()) continue;
+                vectors.push_back({const_cast<char*>(pieces[i].data()), pieces[i].size()});
+            }
+            if (vectors.empty()) return;
+
+            ssize_t written = ::writev(fd, vectors.data(), vectors.size());
+            if (written < 0) {
+                if (errno == EINTR) continue;
+                write_failed();
+            }
+            // drop whatever made it out
+            size_t left = written;
+            while (first < pieces.size() && left >= pieces[first].size()) {
+                left -= pieces[first].size();
+                first++;
+            }
+            if (first < pieces.size()) pieces[first].remove_prefix(left);
+        }
+    }
+#else
+    void write_pieces(int, const std::vector<std::string_view>& pieces) {
+        for (std::string_view piece : pieces) {
+            if (std::fwrite(piece.data(), 1, piece.size(), stdout) != piece.size()) write_failed();
+        }
+        if (std::fflush(stdout) != 0) write_failed();
+    }
+#endif
+}
+
+Output::Output(int fd, bool line_buffered): fd(fd), line_buffered(line_buffered) {
+    buffer.reserve(BUFFER_SIZE + 4096);
+}
+
+Output::~Output() {
+    try {
+        flush();
+    } catch (const std::runtime_error&) {
+        // nowhere left to report it
+    }
+}
+
+void Output::flush() {
+    if (fd < 0 || buffer.empty()) return;
+    write_timed({buffer});
+    // clear keeps the memory for the next lot
+    buffer.clear();
+}
+
+void Output::write(const std::vector<std::string_view>& pieces) {
+    std::vector<std::string_view> all;
+    all.reserve(pieces.size() + 1);
+    all.push_back(buffer);
+    all.insert(all.end(), pieces.begin(), pieces.end());
+    write_timed(all);
+    buffer.clear();
+}
+
+void Output::write_timed(const std::vector<std::string_view>& pieces) {
+    // a couple of clock reads per write is nothing next to the syscall
+    auto start = std::chrono::steady_clock::now();
+    write_pieces(fd, pieces);
+    write_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+string Output::take() {
+    string collected = std::move(buffer);
+    buffer.clear();
+    return collected;
+}
+
+bool is_terminal(int fd) {
+#ifndef WINDOWS
+    return ::isatty(fd) != 0;
+#else
+    return ::_isatty(fd) != 0;
+#endif
+}
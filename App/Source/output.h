@@ -0,0 +1,75 @@
+#pragma once
+
+#include <charconv>
+#include <concepts>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using std::string;
+
+// Where the matching lines go. Everything gets appended to one big buffer, which is written out with a single
+// write(2) when it fills up, rather than a syscall (or several) per line like std::cout with std::unitbuf.
+// An Output without a file descriptor just collects: that's how every parallel search task gets a buffer of
+// its own, which is handed over (and written with everything else that's ready, in one writev) once it's done.
+class Output {
+public:
+    // collect into a buffer for take()
+    Output() = default;
+    // write to fd, flushing after every line too if line_buffered (for someone watching, or a pipe waiting on each line)
+    explicit Output(int fd, bool line_buffered = false);
+    // flushes, but an error writing here gets lost, so call flush first to find out about it
+    ~Output();
+
+    Output(const Output&) = delete;
+    Output& operator=(const Output&) = delete;
+
+    // flush once this much is buffered
+    static constexpr size_t BUFFER_SIZE = 64 * 1024;
+
+    Output& operator<<(std::string_view text) {
+        buffer.append(text);
+        return *this;
+    }
+    Output& operator<<(char ch) {
+        buffer.push_back(ch);
+        return *this;
+    }
+    // line numbers, byte offsets and pattern ids, in decimal
+    template <std::unsigned_integral Number>
+    Output& operator<<(Number number) {
+        char digits[24];
+        auto result = std::to_chars(digits, digits + sizeof(digits), number);
+        buffer.append(digits, result.ptr);
+        return *this;
+    }
+
+    // finish a line with '\n', and flush if we're line buffered or the buffer is full
+    void end_line() {
+        buffer.push_back('\n');
+        if (fd >= 0 && (line_buffered || buffer.size() >= BUFFER_SIZE)) flush();
+    }
+
+    // write out whatever is buffered. throws std::runtime_error if it can't be written
+    void flush();
+    // write whatever is buffered and then pieces, all in one go (as few writevs as it takes)
+    void write(const std::vector<std::string_view>& pieces);
+
+    // what's been collected so far (by an Output without a file descriptor), leaving it empty
+    string take();
+
+    // time spent in write(2) so far, for --stats
+    double seconds_writing() const { return write_seconds; }
+
+private:
+    int fd = -1;
+    bool line_buffered = false;
+    string buffer;
+    double write_seconds = 0;
+
+    void write_timed(const std::vector<std::string_view>& pieces);
+};
+
+// true if fd is a terminal, where lines should go out as they're found even without --line-buffered
+bool is_terminal(int fd);
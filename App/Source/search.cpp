@@ -0,0 +1,459 @@
+#include "search.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+#ifndef WINDOWS
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "block_reader.h"
+#include "glob.h"
+#include "mapped_file.h"
+#include "thread_pool.h"
+
+namespace {
+    // grep's colours for a match, bold red and then back to normal
+    const char* MATCH_COLOR = "\033[01;31m";
+    const char* END_COLOR = "\033[m";
+
+#ifndef WINDOWS
+    // an fd that gets closed when it goes out of scope, even if reading it throws
+    struct OpenFile {
+        int fd;
+        ~OpenFile() {
+            if (fd >= 0) ::close(fd);
+        }
+    };
+#endif
+}
+
+void print_line(Output& out, std::string_view line, size_t offset, const string& filename, Matcher& matcher, const Options& options) {
+    // only worked out for lines that matched, so it doesn't slow down the scan
+    vector<uint32_t> ids;
+    if (options.pattern_ids) matcher.match_patterns(line, ids);
+
+    // what goes in front of every line we print, at is the byte offset of the line (or match) in the file
+    auto print_prefix = [&](size_t at) {
+        if (filename != "") {
+            out << filename << ": ";
+        }
+        if (options.byte_offset) {
+            out << at << ':';
+        }
+        if (options.pattern_ids) {
+            out << '[';
+            for (size_t i = 0; i < ids.size(); i++) {
+                if (i > 0) out << ',';
+                out << ids[i];
+            }
+            out << "] ";
+        }
+    };
+
+    if (options.groups) {
+        matcher.for_each_captures(line, [&](const vector<size_t>& slots) {
+            print_prefix(offset + slots[0]);
+            // a pattern without groups just has the whole match
+            size_t first = slots.size() > 2 ? 1 : 0;
+            for (size_t group = first; 2 * group < slots.size(); group++) {
+                if (group > first) out << '\t';
+                if (slots[2 * group] != std::string_view::npos) out << line.substr(slots[2 * group], slots[2 * group + 1] - slots[2 * group]);
+            }
+            out.end_line();
+        });
+        return;
+    }
+
+    if (options.only_matching) {
+        matcher.for_each_span(line, [&](size_t start, size_t end) {
+            print_prefix(offset + start);
+            if (options.color) out << MATCH_COLOR << line.substr(start, end - start) << END_COLOR;
+            else out << line.substr(start, end - start);
+            out.end_line();
+        });
+        return;
+    }
+
+    print_prefix(offset);
+    if (options.color) {
+        size_t printed = 0;
+        matcher.for_each_span(line, [&](size_t start, size_t end) {
+            out << line.substr(printed, start - printed) << MATCH_COLOR << line.substr(start, end - start) << END_COLOR;
+            printed = end;
+        });
+        line = line.substr(printed);
+    }
+    out << line;
+    out.end_line();
+}
+
+bool looks_binary(std::string_view first_block) {
+    first_block = first_block.substr(0, BlockReader::DEFAULT_BLOCK_SIZE);
+    return std::memchr(first_block.data(), '\0', first_block.size()) != nullptr;
+}
+
+bool run_nfa(BlockReader& reader, Matcher& matcher, bool found, Output& out, const Options& options, string filename, bool skip_binary) {
+    // loop through the file a block at a time looking for the regex
+    // the lines are views into the reader's buffer, so nothing gets copied per line
+    std::string_view block;
+    bool first = true;
+    // how far into the stream the block starts, for -b
+    size_t offset = 0;
+    while (reader.next(block)) {
+        if (first && skip_binary && looks_binary(block)) return found;
+        first = false;
+        matcher.for_each_match(block, [&](std::string_view line) {
+            print_line(out, line, offset + (line.data() - block.data()), filename, matcher, options);
+            found = true;
+        });
+        offset += block.size();
+    }
+    return found;
+}
+
+bool run_nfa(std::string_view contents, Matcher& matcher, bool found, Output& out, const Options& options, string filename, size_t offset) {
+    // the whole (memory mapped) file is one big buffer
+    matcher.for_each_match(contents, [&](std::string_view line) {
+        print_line(out, line, offset + (line.data() - contents.data()), filename, matcher, options);
+        found = true;
+    });
+    return found;
+}
+
+bool search_file(const string& input_file, Matcher& matcher, Output& out, const Options& options, bool skip_binary) {
+    // regular files get mapped and searched in place, anything else gets streamed
+    MappedFile mapped(input_file);
+    if (mapped.is_open()) {
+        if (skip_binary && looks_binary(mapped.contents())) return false;
+        return run_nfa(mapped.contents(), matcher, false, out, options, input_file);
+    }
+
+#ifndef WINDOWS
+    OpenFile file{ ::open(input_file.c_str(), O_RDONLY | O_CLOEXEC) };
+    if (file.fd < 0) {
+        throw std::runtime_error("couldn't open file for reading: " + input_file);
+    }
+    // a directory opens fine but can't be read, and without -r it just has no lines in it
+    struct stat info;
+    if (fstat(file.fd, &info) == 0 && S_ISDIR(info.st_mode)) return false;
+    BlockReader reader(file.fd);
+    try {
+        return run_nfa(reader, matcher, false, out, options, input_file, skip_binary);
+    }
+    catch (const std::runtime_error& e) {
+        throw std::runtime_error(string(e.what()) + ": " + input_file);
+    }
+#else
+    std::ifstream ifs(input_file);
+    if (!ifs) {
+        throw std::runtime_error("couldn't open file for reading: " + input_file);
+    }
+    BlockReader reader(ifs);
+    return run_nfa(reader, matcher, false, out, options, input_file, skip_binary);
+#endif
+}
+
+bool search_stdin(Matcher& matcher, Output& out, const Options& options) {
+#ifndef WINDOWS
+    BlockReader reader(STDIN_FILENO);
+#else
+    BlockReader reader(std::cin);
+#endif
+    return run_nfa(reader, matcher, false, out, options);
+}
+
+namespace {
+    namespace fs = std::filesystem;
+
+    // the results for one command line argument, which is a single file unless it's a directory we're walking
+    struct ArgumentResult {
+        // (path, matching lines) for every file that printed something, a big file's lines come in one piece per chunk
+        std::vector<std::pair<string, std::vector<string>>> outputs;
+        std::vector<string> errors;
+        bool found = false;
+        bool done = false;
+        // tasks still working on this argument, when it gets to 0 the argument is done
+        std::atomic<size_t> pending{1};
+    };
+
+    // files at least twice this big get split into chunks of about this size and searched by several workers at once
+    constexpr size_t CHUNK_SIZE = 16 * 1024 * 1024;
+
+    class ParallelSearch {
+    public:
+        ParallelSearch(const Options& options, const Regex& regex, Output& out);
+        int run();
+        // every worker's matcher added up, once run has finished
+        MatchStats stats() const;
+
+    private:
+        const Options& options;
+        Output& out;
+        ThreadPool pool;
+        // the regex is shared and never changes, but the dfa cache in each Matcher does, so every worker gets its own
+        std::vector<Matcher> matchers;
+        std::vector<ArgumentResult> results;
+        // guards the results (and printing, in unordered mode)
+        std::mutex mutex;
+        std::condition_variable finished;
+
+        void search_argument(ArgumentResult& result, const string& path, unsigned worker);
+        void search_one(ArgumentResult& result, const string& path, unsigned worker, bool skip_binary);
+        void search_chunks(ArgumentResult& result, const string& path, std::shared_ptr<MappedFile> mapped);
+        void add_output(ArgumentResult& result, const string& path, std::vector<string> output, bool found, const string& error);
+        void print_error(const string& error);
+        void walk_directory(ArgumentResult& result, const fs::path& directory);
+        void spawn(ArgumentResult& result, std::function<void(unsigned)> task);
+        void task_done(ArgumentResult& result);
+        bool wanted_file(const string& name) const;
+        bool wanted_directory(const string& name) const;
+    };
+
+    ParallelSearch::ParallelSearch(const Options& options, const Regex& regex, Output& out): options(options), out(out), pool(options.jobs), results(options.files.size()) {
+        matchers.reserve(pool.size());
+        for (unsigned i = 0; i < pool.size(); i++) {
+            matchers.emplace_back(regex);
+            matchers.back().collect_stats(options.stats);
+        }
+    }
+
+    MatchStats ParallelSearch::stats() const {
+        MatchStats total;
+        for (const Matcher& matcher : matchers) total += matcher.stats();
+        return total;
+    }
+
+    int ParallelSearch::run() {
+        for (size_t i = 0; i < options.files.size(); i++) {
+            ArgumentResult& result = results[i];
+            const string& path = options.files[i];
+            pool.submit([this, &result, &path](unsigned worker) {
+                search_argument(result, path, worker);
+                task_done(result);
+            });
+        }
+
+        bool found = false;
+        bool failed = false;
+        for (ArgumentResult& result : results) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                finished.wait(lock, [&] { return result.done; });
+            }
+            // nobody touches a result once it's done, so it can be printed without holding the lock
+            found = found || result.found;
+            if (options.unordered || (failed && !options.recursive)) continue;
+
+            std::sort(result.outputs.begin(), result.outputs.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+            // every file of the argument goes out together, straight from the workers' buffers
+            std::vector<std::string_view> pieces;
+            for (const auto& output : result.outputs) pieces.insert(pieces.end(), output.second.begin(), output.second.end());
+            out.write(pieces);
+            for (const string& error : result.errors) print_error(error);
+            // a file we couldn't read stops the output, like it does when searching one file at a time
+            // a recursive search keeps going past the odd unreadable file instead
+            if (!result.errors.empty()) failed = true;
+        }
+
+        // let any stragglers (ordered mode stops printing early) finish before the matchers go away
+        pool.wait();
+        if (failed) return 2;
+        return found ? 0 : 1;
+    }
+
+    void ParallelSearch::search_argument(ArgumentResult& result, const string& path, unsigned worker) {
+        std::error_code ec;
+        if (options.recursive && fs::is_directory(path, ec)) {
+            walk_directory(result, path);
+            return;
+        }
+        // files named on the command line get searched even if they look binary, unless we're recursing
+        search_one(result, path, worker, options.recursive);
+    }
+
+    void ParallelSearch::search_one(ArgumentResult& result, const string& path, unsigned worker, bool skip_binary) {
+        // every task gets its own buffer, so workers never wait on each other to print a line
+        Output output;
+        string error;
+        bool found = false;
+
+        auto mapped = std::make_shared<MappedFile>(path);
+        if (mapped->is_open()) {
+            std::string_view contents = mapped->contents();
+            if (skip_binary && looks_binary(contents)) return;
+            if (pool.size() > 1 && contents.size() >= 2 * CHUNK_SIZE) {
+                search_chunks(result, path, std::move(mapped));
+                return;
+            }
+            found = run_nfa(contents, matchers[worker], false, output, options, path);
+        }
+        else {
+            try {
+                found = search_file(path, matchers[worker], output, options, skip_binary);
+            } catch (const std::runtime_error& e) {
+                error = e.what();
+            }
+        }
+        add_output(result, path, {output.take()}, found, error);
+    }
+
+    void ParallelSearch::search_chunks(ArgumentResult& result, const string& path, std::shared_ptr<MappedFile> mapped) {
+        // lines are independent, so a big file can be cut up at newlines and every piece searched at the same time
+        struct Chunks {
+            std::shared_ptr<MappedFile> mapped;
+            string path;
+            std::vector<string> outputs;
+            std::vector<char> found;
+            std::atomic<size_t> remaining{0};
+        };
+
+        std::string_view contents = mapped->contents();
+        std::vector<std::pair<size_t, size_t>> bounds;
+        size_t begin = 0;
+        while (begin < contents.size()) {
+            size_t end = begin + CHUNK_SIZE;
+            if (end >= contents.size()) {
+                end = contents.size();
+            }
+            else {
+                // finish the chunk just after the next newline
+                end = contents.find('\n', end);
+                end = end == std::string_view::npos ? contents.size() : end + 1;
+            }
+            bounds.emplace_back(begin, end);
+            begin = end;
+        }
+
+        auto chunks = std::make_shared<Chunks>();
+        chunks->mapped = std::move(mapped);
+        chunks->path = path;
+        chunks->outputs.resize(bounds.size());
+        chunks->found.resize(bounds.size(), false);
+        chunks->remaining = bounds.size();
+
+        for (size_t i = 0; i < bounds.size(); i++) {
+            size_t offset = bounds[i].first;
+            std::string_view chunk = contents.substr(offset, bounds[i].second - offset);
+            spawn(result, [this, &result, chunks, chunk, offset, i](unsigned worker) {
+                Output output;
+                chunks->found[i] = run_nfa(chunk, matchers[worker], false, output, options, chunks->path, offset);
+                chunks->outputs[i] = output.take();
+                if (--chunks->remaining > 0) return;
+
+                // last one done hands the pieces over in file order, they get written out back to back
+                bool found = false;
+                for (size_t j = 0; j < chunks->outputs.size(); j++) {
+                    found = found || chunks->found[j];
+                }
+                add_output(result, chunks->path, std::move(chunks->outputs), found, "");
+            });
+        }
+    }
+
+    void ParallelSearch::add_output(ArgumentResult& result, const string& path, std::vector<string> output, bool found, const string& error) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (options.unordered) {
+            // print it now, one file's output at a time
+            out.write({output.begin(), output.end()});
+            if (!error.empty()) print_error(error);
+        }
+        else if (found) {
+            result.outputs.emplace_back(path, std::move(output));
+        }
+        if (!error.empty()) result.errors.push_back(error);
+        result.found = result.found || found;
+    }
+
+    void ParallelSearch::walk_directory(ArgumentResult& result, const fs::path& directory) {
+        // every directory is its own task, so big trees get listed by all the workers at once
+        std::error_code ec;
+        fs::directory_iterator entries(directory, ec);
+        if (ec) {
+            std::lock_guard<std::mutex> lock(mutex);
+            string error = "couldn't open directory for reading: " + directory.string();
+            if (options.unordered) print_error(error);
+            result.errors.push_back(error);
+            return;
+        }
+
+        for (const fs::directory_entry& entry : entries) {
+            // like grep -r, don't follow symlinks we find along the way
+            fs::file_status status = entry.symlink_status(ec);
+            if (ec) continue;
+            string name = entry.path().filename().string();
+
+            if (fs::is_directory(status)) {
+                if (!wanted_directory(name)) continue;
+                fs::path subdirectory = entry.path();
+                spawn(result, [this, &result, subdirectory](unsigned) {
+                    walk_directory(result, subdirectory);
+                });
+            }
+            else if (fs::is_regular_file(status)) {
+                if (!wanted_file(name)) continue;
+                string path = entry.path().string();
+                spawn(result, [this, &result, path](unsigned worker) {
+                    search_one(result, path, worker, true);
+                });
+            }
+        }
+    }
+
+    void ParallelSearch::spawn(ArgumentResult& result, std::function<void(unsigned)> task) {
+        result.pending++;
+        pool.submit([this, &result, task = std::move(task)](unsigned worker) {
+            task(worker);
+            task_done(result);
+        });
+    }
+
+    void ParallelSearch::task_done(ArgumentResult& result) {
+        if (--result.pending > 0) return;
+        std::lock_guard<std::mutex> lock(mutex);
+        result.done = true;
+        finished.notify_all();
+    }
+
+    bool ParallelSearch::wanted_file(const string& name) const {
+        for (const string& glob : options.exclude) {
+            if (glob_match(glob, name)) return false;
+        }
+        if (options.include.empty()) return true;
+        for (const string& glob : options.include) {
+            if (glob_match(glob, name)) return true;
+        }
+        return false;
+    }
+
+    void ParallelSearch::print_error(const string& error) {
+        // whatever matched before the error goes out first
+        out.flush();
+        std::cerr << error << std::endl;
+    }
+
+    bool ParallelSearch::wanted_directory(const string& name) const {
+        for (const string& glob : options.exclude_dir) {
+            if (glob_match(glob, name)) return false;
+        }
+        return true;
+    }
+}
+
+int search_files_parallel(const Options& options, const Regex& regex, Output& out, MatchStats& stats) {
+    ParallelSearch search(options, regex, out);
+    int status = search.run();
+    stats = search.stats();
+    return status;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+#include "../../Core/Source/Core/matcher.h"
+#include "../../Core/Source/Core/regex.h"
+#include "block_reader.h"
+#include "options.h"
+#include "output.h"
+
+using std::string;
+
+// print one matching line, with the filename in front if there is one
+// (and its byte offset with -b, and the ids of the patterns that matched it with --pattern-ids)
+// with -o just its matches get printed, one per line, and with --color they get highlighted
+// with --groups it's each match's capture groups instead, separated by tabs
+// offset is where the line starts in its file
+void print_line(Output& out, std::string_view line, size_t offset, const string& filename, Matcher& matcher, const Options& options);
+
+// true if the start of a file has a NUL byte in it, which text files never do
+bool looks_binary(std::string_view first_block);
+
+// search a stream a block at a time, returns true if anything matched (or found was already true)
+// with skip_binary, a stream whose first block looks binary doesn't get searched at all
+bool run_nfa(BlockReader& reader, Matcher& matcher, bool found, Output& out, const Options& options, string filename = "", bool skip_binary = false);
+// search a buffer that holds a whole file (or the piece of one that starts offset bytes in)
+bool run_nfa(std::string_view contents, Matcher& matcher, bool found, Output& out, const Options& options, string filename = "", size_t offset = 0);
+
+// search one file, memory mapping it if we can. throws std::runtime_error if it can't be opened
+bool search_file(const string& input_file, Matcher& matcher, Output& out, const Options& options, bool skip_binary = false);
+// search standard input. throws std::runtime_error if it can't be read
+bool search_stdin(Matcher& matcher, Output& out, const Options& options);
+
+// search options.files on options.jobs threads, each with its own Matcher over the shared regex
+// big regular files get split at newlines and their pieces searched at the same time
+// with options.recursive, directories get walked in parallel too, and their files get fed to the same workers
+// output is printed per argument, in argument order unless options.unordered is set (a directory's files come out sorted by path)
+// returns 0 if anything matched, 1 if nothing did, 2 if something couldn't be read
+// stats gets what all the workers' matchers did (their line counts only with options.stats)
+int search_files_parallel(const Options& options, const Regex& regex, Output& out, MatchStats& stats);
@@ -0,0 +1,62 @@
+#include "stats_report.h"
+
+#include <cstdio>
+#include <string>
+
+namespace {
+    void row(std::ostream& out, const char* name, const std::string& value) {
+        char label[32];
+        std::snprintf(label, sizeof(label), "  %-20s", name);
+        out << label << value << '\n';
+    }
+
+    void row(std::ostream& out, const char* name, uint64_t value) {
+        row(out, name, std::to_string(value));
+    }
+
+    std::string milliseconds(double seconds) {
+        char text[32];
+        std::snprintf(text, sizeof(text), "%.3f ms", seconds * 1000);
+        return text;
+    }
+
+    // part of whole as a percentage, for the rows where the ratio is what you actually want to know
+    std::string with_percent(uint64_t part, uint64_t whole) {
+        std::string text = std::to_string(part);
+        if (whole == 0) return text;
+        char percent[32];
+        std::snprintf(percent, sizeof(percent), " (%.1f%%)", 100.0 * part / whole);
+        return text + percent;
+    }
+}
+
+void print_stats(std::ostream& out, const Regex& regex, const MatchStats& stats, double search_seconds, double output_seconds) {
+    const CompileStats& compiled = regex.get_compile_stats();
+    out << "grape stats:\n";
+    row(out, "engine", stats.engine ? stats.engine : "none");
+    row(out, "patterns", compiled.patterns);
+    row(out, "nfa states", compiled.nfa_states);
+    if (compiled.reverse_nfa_states > 0) row(out, "reverse nfa states", compiled.reverse_nfa_states);
+    row(out, "byte classes", compiled.byte_classes);
+
+    uint64_t lines = stats.lines_skipped + stats.lines_tested;
+    row(out, "bytes scanned", stats.bytes_scanned);
+    row(out, "bytes skipped", with_percent(stats.bytes_skipped, stats.bytes_scanned));
+    row(out, "lines skipped", with_percent(stats.lines_skipped, lines));
+    row(out, "lines tested", with_percent(stats.lines_tested, lines));
+    row(out, "lines matched", with_percent(stats.lines_matched, lines));
+
+    // these are all 0 when nothing ever got as far as the lazy dfa
+    row(out, "dfa cache hits", with_percent(stats.dfa_cache_hits, stats.dfa_cache_hits + stats.dfa_cache_misses));
+    row(out, "dfa cache misses", stats.dfa_cache_misses);
+    row(out, "dfa flushes", stats.dfa_flushes);
+    row(out, "dfa peak states", stats.dfa_peak_states);
+    row(out, "dfa fallbacks", stats.dfa_fallbacks);
+    row(out, "nfa peak threads", stats.nfa_peak_threads);
+
+    row(out, "parse time", milliseconds(compiled.parse_seconds));
+    row(out, "compile time", milliseconds(compiled.compile_seconds));
+    // with -j the search time is wall clock, with several threads matching at once
+    row(out, "scan time", milliseconds(search_seconds - output_seconds));
+    row(out, "output time", milliseconds(output_seconds));
+}
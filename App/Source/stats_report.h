@@ -0,0 +1,10 @@
+#pragma once
+
+#include <ostream>
+
+#include "../../Core/Source/Core/regex.h"
+#include "../../Core/Source/Core/stats.h"
+
+// print --stats: what compiling cost, what the matchers did and where the time went
+// search_seconds is the whole search (matching, formatting and writing), output_seconds the part spent in write(2)
+void print_stats(std::ostream& out, const Regex& regex, const MatchStats& stats, double search_seconds, double output_seconds);
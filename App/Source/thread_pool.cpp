@@ -0,0 +1,97 @@
+#include "thread_pool.h"
+
+namespace {
+    // which pool and worker the current thread belongs to, so submit knows whose queue to use
+    thread_local const ThreadPool* current_pool = nullptr;
+    thread_local unsigned current_worker = 0;
+}
+
+ThreadPool::ThreadPool(unsigned workers) {
+    if (workers == 0) workers = 1;
+    for (unsigned i = 0; i < workers; i++) {
+        queues.push_back(std::make_unique<Queue>());
+    }
+    for (unsigned i = 0; i < workers; i++) {
+        threads.emplace_back(&ThreadPool::worker_loop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    wait();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    work_available.notify_all();
+    for (std::thread& thread : threads) thread.join();
+}
+
+void ThreadPool::submit(Task task) {
+    unsigned index;
+    {
+        // counted before it goes in a queue: a worker can take it (and count it off) as soon as it's there,
+        // and unfinished mustn't go down before it's gone up, or wait() could return with it still running
+        std::lock_guard<std::mutex> lock(mutex);
+        queued++;
+        unfinished++;
+        index = current_pool == this ? current_worker : next_queue++ % queues.size();
+    }
+    {
+        std::lock_guard<std::mutex> lock(queues[index]->mutex);
+        queues[index]->tasks.push_back(std::move(task));
+    }
+    work_available.notify_one();
+}
+
+void ThreadPool::wait() {
+    std::unique_lock<std::mutex> lock(mutex);
+    all_done.wait(lock, [this] { return unfinished == 0; });
+}
+
+bool ThreadPool::take(unsigned index, Task& task) {
+    // newest task from our own queue first, it's the most likely to still be in cache
+    {
+        Queue& own = *queues[index];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+    // then the oldest task from everyone else
+    for (unsigned i = 1; i < queues.size(); i++) {
+        Queue& other = *queues[(index + i) % queues.size()];
+        std::lock_guard<std::mutex> lock(other.mutex);
+        if (!other.tasks.empty()) {
+            task = std::move(other.tasks.front());
+            other.tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::worker_loop(unsigned index) {
+    current_pool = this;
+    current_worker = index;
+
+    while (true) {
+        Task task;
+        if (take(index, task)) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                queued--;
+            }
+            task(index);
+            std::lock_guard<std::mutex> lock(mutex);
+            if (--unfinished == 0) all_done.notify_all();
+            continue;
+        }
+
+        // nothing to take anywhere, sleep until something gets submitted
+        std::unique_lock<std::mutex> lock(mutex);
+        work_available.wait(lock, [this] { return stopping || queued > 0; });
+        if (stopping && queued == 0) return;
+    }
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work stealing thread pool.
+// Every worker has its own queue: it takes work from the back of its own queue and, when that runs dry,
+// steals from the front of everyone else's. Tasks get told which worker runs them, so callers can keep
+// per-worker state (like a Matcher and its dfa cache) without any locking.
+class ThreadPool {
+public:
+    using Task = std::function<void(unsigned worker)>;
+
+    explicit ThreadPool(unsigned workers);
+    // waits for everything that's been submitted to finish
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    unsigned size() const { return threads.size(); }
+
+    // queue a task. from inside a task it goes on the current worker's own queue
+    void submit(Task task);
+
+    // block until every submitted task (including ones submitted by tasks) has finished
+    void wait();
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> threads;
+
+    // guards the counters below, and the condition variables wait on it
+    std::mutex mutex;
+    std::condition_variable work_available;
+    std::condition_variable all_done;
+    size_t queued = 0; // sitting in a queue
+    size_t unfinished = 0; // queued or running
+    unsigned next_queue = 0;
+    bool stopping = false;
+
+    void worker_loop(unsigned index);
+    bool take(unsigned index, Task& task);
+};
@@ -0,0 +1,130 @@
+#include "corpus.h"
+
+#include <unordered_set>
+
+using std::string, std::vector;
+
+namespace {
+    const char* LEVELS[] = { "DEBUG", "INFO", "INFO", "INFO", "INFO", "WARN", "ERROR" };
+    const char* SERVICES[] = { "auth", "billing", "gateway", "search", "storage", "scheduler" };
+    const char* MESSAGES[] = {
+        "request served", "cache miss", "cache hit", "user logged in", "user logged out", "retrying request",
+        "connection timeout after", "connection refused by", "connection reset by peer", "host unreachable from",
+        "queue depth", "slow query took",
+    };
+    const char* DOMAINS[] = { "com", "org", "net", "io" };
+
+    template <typename T, size_t N>
+    const T& pick(Rng& rng, const T (&options)[N]) {
+        return options[rng.below(N)];
+    }
+
+    void append_number(string& out, uint64_t n, int width = 0) {
+        char digits[20];
+        int length = 0;
+        do {
+            digits[length++] = static_cast<char>('0' + n % 10);
+            n /= 10;
+        } while (n != 0);
+        for (int i = length; i < width; i++) out += '0';
+        while (length > 0) out += digits[--length];
+    }
+}
+
+vector<string> make_words(size_t count, uint64_t seed) {
+    static const char CONSONANTS[] = "bcdfghjklmnprstvz";
+    static const char VOWELS[] = "aeiou";
+    Rng rng(seed);
+    vector<string> words;
+    std::unordered_set<string> seen;
+    while (words.size() < count) {
+        string word;
+        uint32_t syllables = rng.between(2, 4);
+        for (uint32_t i = 0; i < syllables; i++) {
+            word += CONSONANTS[rng.below(sizeof(CONSONANTS) - 1)];
+            word += VOWELS[rng.below(sizeof(VOWELS) - 1)];
+        }
+        if (seen.insert(word).second) words.push_back(std::move(word));
+    }
+    return words;
+}
+
+string log_lines(size_t bytes, uint64_t seed) {
+    Rng rng(seed);
+    vector<string> users = make_words(200, seed ^ 0x5555);
+    string out;
+    out.reserve(bytes + 256);
+    uint64_t time = 0;
+    while (out.size() < bytes) {
+        time += rng.between(1, 2000);
+        out += "2024-03-";
+        append_number(out, 1 + time / 86400000 % 28, 2);
+        out += ' ';
+        append_number(out, time / 3600000 % 24, 2);
+        out += ':';
+        append_number(out, time / 60000 % 60, 2);
+        out += ':';
+        append_number(out, time / 1000 % 60, 2);
+        out += '.';
+        append_number(out, time % 1000, 3);
+        out += ' ';
+        out += pick(rng, LEVELS);
+        out += ' ';
+        out += pick(rng, SERVICES);
+        out += ": user=";
+        out += users[rng.below(users.size())];
+        out += " id=";
+        append_number(out, rng.below(1000000));
+        out += ' ';
+        out += pick(rng, MESSAGES);
+        out += ' ';
+        append_number(out, rng.below(5000));
+        out += "ms\n";
+    }
+    return out;
+}
+
+string a_runs(size_t bytes, uint64_t seed) {
+    Rng rng(seed);
+    string out;
+    out.reserve(bytes + 128);
+    while (out.size() < bytes) {
+        out.append(rng.between(10, 100), 'a');
+        if (rng.below(50) == 0) out += 'b';
+        out += '\n';
+    }
+    return out;
+}
+
+string ab_lines(size_t bytes, uint64_t seed) {
+    Rng rng(seed);
+    string out;
+    out.reserve(bytes + 128);
+    while (out.size() < bytes) {
+        uint32_t length = rng.between(20, 120);
+        for (uint32_t i = 0; i < length; i++) out += rng.below(2) ? 'a' : 'b';
+        out += '\n';
+    }
+    return out;
+}
+
+string word_lines(const vector<string>& words, size_t bytes, uint64_t seed) {
+    Rng rng(seed);
+    string out;
+    out.reserve(bytes + 256);
+    while (out.size() < bytes) {
+        uint32_t count = rng.between(4, 16);
+        for (uint32_t i = 0; i < count; i++) {
+            if (i > 0) out += ' ';
+            out += words[rng.below(words.size())];
+            if (rng.below(40) == 0) {
+                out += '@';
+                out += words[rng.below(words.size())];
+                out += '.';
+                out += pick(rng, DOMAINS);
+            }
+        }
+        out += '\n';
+    }
+    return out;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Synthetic inputs for the benchmarks.
+// Everything comes out of a seeded splitmix64 rather than <random>, whose distributions are allowed to differ
+// between standard libraries, so the same seed and size give the same bytes on every machine and results
+// from different versions (or compilers) are measuring the same thing.
+class Rng {
+public:
+    explicit Rng(uint64_t seed) : state(seed) {}
+
+    uint64_t next() {
+        uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+    // in [0, n), n has to be > 0
+    uint32_t below(uint32_t n) { return static_cast<uint32_t>(next() % n); }
+    // in [lo, hi]
+    uint32_t between(uint32_t lo, uint32_t hi) { return lo + below(hi - lo + 1); }
+
+private:
+    uint64_t state;
+};
+
+// pronounceable made up words ("tavolu", "kesiba"), all different, so a pattern set can be built from the
+// same words the text is made of
+std::vector<std::string> make_words(size_t count, uint64_t seed);
+
+// each of these makes about bytes of '\n' separated lines (always whole lines)
+
+// application log lines: timestamp, level, service, user, id and a message, with the odd error in among them
+std::string log_lines(size_t bytes, uint64_t seed);
+// runs of 'a', the odd one ending in 'b', for patterns like (a|aa)*b
+std::string a_runs(size_t bytes, uint64_t seed);
+// random lines of a's and b's, for patterns whose dfa blows up
+std::string ab_lines(size_t bytes, uint64_t seed);
+// lines of words, with some email address looking tokens in among them
+std::string word_lines(const std::vector<std::string>& words, size_t bytes, uint64_t seed);
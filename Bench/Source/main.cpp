@@ -0,0 +1,473 @@
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "../../Core/Source/Core/dense_dfa.h"
+#include "../../Core/Source/Core/lazy_dfa.h"
+#include "../../Core/Source/Core/matcher.h"
+#include "../../Core/Source/Core/regex.h"
+#include "../../Core/Source/Core/static_regex.h"
+#include "corpus.h"
+#include "measure.h"
+
+using std::string, std::string_view, std::vector;
+
+// Benchmarks every engine grape has on synthetic inputs, and writes the results out as JSON lines (one object
+// per line) so two runs can be diffed or loaded into a script. A progress table goes to stderr.
+//
+// Records:
+//   {"record":"run", ...}      the settings, once at the top
+//   {"record":"compile", ...}  parsing and compiling a case's patterns into a Regex
+//   {"record":"scan", ...}     one engine searching a case's input, or "skipped" if it can't be built for it
+// Bump FORMAT when a field changes meaning, so old results don't get compared with new ones by accident.
+
+namespace {
+    constexpr int FORMAT = 1;
+    const char* USAGE = "usage: bench [--size MiB] [--reps N] [--max-seconds S] [--seed N] [--case NAME] [--engine NAME] [--out FILE] [--list]";
+
+    struct BenchOptions {
+        size_t size_mib = 8;
+        int reps = 3;
+        // a pass over the input stops early after this long, so the slow engines on the pathological cases finish
+        double max_seconds = 1.0;
+        uint64_t seed = 1;
+        // only run cases / engines whose names contain these
+        string case_filter;
+        string engine_filter;
+        string out_path;
+        bool list = false;
+    };
+
+    bool parse_number(const string& value, double& number) {
+        try {
+            size_t used = 0;
+            number = std::stod(value, &used);
+            return used == value.size() && number >= 0;
+        }
+        catch (const std::exception&) {
+            return false;
+        }
+    }
+
+    bool parse_options(int argc, char* argv[], BenchOptions& options) {
+        for (int i = 1; i < argc; i++) {
+            string arg = argv[i];
+            if (arg == "--list") {
+                options.list = true;
+                continue;
+            }
+            if (arg != "--size" && arg != "--reps" && arg != "--max-seconds" && arg != "--seed" && arg != "--case"
+                && arg != "--engine" && arg != "--out") {
+                std::cerr << "Unknown option '" << arg << "'" << std::endl << USAGE << std::endl;
+                return false;
+            }
+            if (i + 1 >= argc) {
+                std::cerr << "Expected a value after '" << arg << "'" << std::endl;
+                return false;
+            }
+            string value = argv[++i];
+            if (arg == "--case") options.case_filter = value;
+            else if (arg == "--engine") options.engine_filter = value;
+            else if (arg == "--out") options.out_path = value;
+            else {
+                double number = 0;
+                if (!parse_number(value, number) || (arg != "--max-seconds" && number != static_cast<uint64_t>(number))) {
+                    std::cerr << "Expected a number after '" << arg << "', got '" << value << "'" << std::endl;
+                    return false;
+                }
+                if (arg == "--size") options.size_mib = std::max<size_t>(1, static_cast<size_t>(number));
+                else if (arg == "--reps") options.reps = std::max(1, static_cast<int>(number));
+                else if (arg == "--max-seconds") options.max_seconds = number;
+                else options.seed = static_cast<uint64_t>(number);
+            }
+        }
+        return true;
+    }
+
+    // builds up one JSON object, fields in the order they're added so the output diffs cleanly
+    class JsonLine {
+    public:
+        JsonLine& field(string_view name, string_view value) {
+            key(name);
+            text += '"';
+            for (char c : value) {
+                if (c == '"' || c == '\\') {
+                    text += '\\';
+                    text += c;
+                }
+                else if (static_cast<unsigned char>(c) < 0x20) {
+                    char escaped[8];
+                    std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                    text += escaped;
+                }
+                else text += c;
+            }
+            text += '"';
+            return *this;
+        }
+        JsonLine& field(string_view name, const char* value) { return field(name, string_view(value)); }
+        JsonLine& field(string_view name, uint64_t value) {
+            key(name);
+            text += std::to_string(value);
+            return *this;
+        }
+        JsonLine& field(string_view name, double value) {
+            key(name);
+            char number[32];
+            std::snprintf(number, sizeof(number), "%.3f", value);
+            text += number;
+            return *this;
+        }
+        JsonLine& field(string_view name, bool value) {
+            key(name);
+            text += value ? "true" : "false";
+            return *this;
+        }
+
+        string str() const { return text + "}"; }
+
+    private:
+        string text = "{";
+
+        void key(string_view name) {
+            if (text.size() > 1) text += ',';
+            text += '"';
+            text += name;
+            text += "\":";
+        }
+    };
+
+    struct Case {
+        const char* name;
+        const char* corpus;
+        vector<string> patterns;
+        // the same pattern as a StaticRegex, for the cases where it's fixed at build time
+        bool (*static_match)(string_view) = nullptr;
+    };
+
+    struct Pass {
+        size_t bytes = 0;
+        size_t matches = 0;
+        double seconds = 0;
+        bool complete = true;
+        AllocationCount allocations;
+    };
+
+    double mb_per_s(const Pass& pass) {
+        return pass.seconds > 0 ? pass.bytes / pass.seconds / 1e6 : 0.0;
+    }
+
+    double milliseconds(double seconds) { return seconds * 1000; }
+
+    // everything a case's engines share
+    struct Context {
+        const BenchOptions& options;
+        std::ostream& out;
+        const Case& test;
+        const string& corpus;
+        // the corpus split into lines, for the engines that match a line at a time, and into 64 KiB blocks
+        // (ending at line boundaries, like the blocks grape reads files in) for Matcher, which finds its own lines
+        vector<string_view> lines;
+        vector<string_view> blocks;
+        // matching lines counted by the first engine to get through the whole input, the rest should agree
+        std::optional<size_t> expected_matches;
+    };
+
+    // one pass over pieces, stopping early if it goes over max_seconds
+    template <typename Engine, typename Scan>
+    Pass run_pass(const Context& context, const vector<string_view>& pieces, Engine& engine, Scan& scan) {
+        Pass pass;
+        AllocationCount before = allocations_so_far();
+        Stopwatch stopwatch;
+        size_t unchecked = 0;
+        for (size_t i = 0; i < pieces.size(); i++) {
+            pass.matches += scan(engine, pieces[i]);
+            pass.bytes += pieces[i].size() + 1;
+            // the clock isn't free, so only look at it every 16 KiB or so
+            unchecked += pieces[i].size() + 1;
+            if (unchecked >= 16 * 1024 && i + 1 < pieces.size()) {
+                unchecked = 0;
+                if (stopwatch.seconds() > context.options.max_seconds) {
+                    pass.complete = false;
+                    break;
+                }
+            }
+        }
+        pass.seconds = stopwatch.seconds();
+        AllocationCount after = allocations_so_far();
+        pass.allocations = { after.allocations - before.allocations, after.bytes - before.bytes };
+        return pass;
+    }
+
+    void progress(const Context& context, const char* engine, const string& result) {
+        std::fprintf(stderr, "%-18s %-14s %s\n", context.test.name, engine, result.c_str());
+    }
+
+    bool wanted(const Context& context, const char* engine) {
+        return string_view(engine).find(context.options.engine_filter) != string_view::npos;
+    }
+
+    void skipped(Context& context, const char* engine, const string& reason) {
+        if (!wanted(context, engine)) return;
+        context.out << JsonLine().field("record", "scan").field("case", context.test.name).field("engine", engine)
+            .field("skipped", reason).str() << '\n';
+        progress(context, engine, "skipped: " + reason);
+    }
+
+    // build an engine and time it searching the input: one cold pass (caches empty), then the best of reps warm ones
+    // build returns the engine, scan(engine, piece) returns how many lines in piece match, and describe adds
+    // anything engine specific to the record once we're done
+    template <typename Build, typename Scan, typename Describe>
+    void bench_engine(Context& context, const char* engine_name, const vector<string_view>& pieces, Build&& build,
+                      Scan&& scan, Describe&& describe) {
+        if (!wanted(context, engine_name)) return;
+
+        reset_peak_rss();
+        size_t rss_before = current_rss_kib();
+        AllocationCount before = allocations_so_far();
+        Stopwatch build_time;
+        auto engine = build();
+        double build_seconds = build_time.seconds();
+        AllocationCount built = allocations_so_far();
+
+        Pass cold = run_pass(context, pieces, engine, scan);
+        Pass best;
+        uint64_t warm_allocations = 0;
+        for (int rep = 0; rep < context.options.reps; rep++) {
+            Pass warm = run_pass(context, pieces, engine, scan);
+            warm_allocations = std::max(warm_allocations, warm.allocations.allocations);
+            if (rep == 0 || mb_per_s(warm) > mb_per_s(best)) best = warm;
+        }
+
+        JsonLine record;
+        record.field("record", "scan").field("case", context.test.name).field("engine", engine_name)
+            .field("build_ms", milliseconds(build_seconds))
+            .field("build_allocations", built.allocations - before.allocations)
+            .field("corpus_bytes", static_cast<uint64_t>(context.corpus.size()))
+            .field("scanned_bytes", static_cast<uint64_t>(best.bytes))
+            .field("complete", best.complete)
+            .field("matching_lines", static_cast<uint64_t>(best.matches))
+            .field("mb_per_s", mb_per_s(best))
+            .field("cold_mb_per_s", mb_per_s(cold))
+            .field("cold_allocations", cold.allocations.allocations)
+            .field("cold_allocated_bytes", cold.allocations.bytes)
+            .field("warm_allocations", warm_allocations)
+            .field("rss_before_kib", static_cast<uint64_t>(rss_before))
+            .field("peak_rss_kib", static_cast<uint64_t>(peak_rss_kib()));
+        describe(engine, record);
+        context.out << record.str() << '\n';
+
+        char summary[128];
+        std::snprintf(summary, sizeof(summary), "%9.1f MB/s%s  %llu allocs warm", mb_per_s(best),
+                      best.complete ? "" : " (partial)", static_cast<unsigned long long>(warm_allocations));
+        progress(context, engine_name, summary);
+
+        if (best.complete) {
+            if (!context.expected_matches) context.expected_matches = best.matches;
+            else if (*context.expected_matches != best.matches) {
+                std::fprintf(stderr, "warning: %s found %zu matching lines in %s, expected %zu\n", engine_name,
+                             best.matches, context.test.name, *context.expected_matches);
+            }
+        }
+    }
+
+    constexpr auto no_details = [](const auto&, JsonLine&) {};
+
+    // pieces of at least block_size bytes that end at a '\n' (which isn't included), so a block_size of 1 gives the lines
+    vector<string_view> split(const string& corpus, size_t block_size) {
+        vector<string_view> pieces;
+        size_t pos = 0;
+        while (pos < corpus.size()) {
+            size_t end = corpus.find('\n', std::min(corpus.size(), pos + block_size) - 1);
+            if (end == string::npos) end = corpus.size();
+            pieces.push_back(string_view(corpus).substr(pos, end - pos));
+            pos = end + 1;
+        }
+        return pieces;
+    }
+
+    string join(const vector<string>& words, size_t from, size_t to, const char* separator) {
+        string joined;
+        for (size_t i = from; i < to; i++) {
+            if (i > from) joined += separator;
+            joined += words[i];
+        }
+        return joined;
+    }
+
+    vector<Case> make_cases(const vector<string>& words) {
+        const string lower = "abcdefghijklmnopqrstuvwxyz";
+        const string alnum = lower + "ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
+
+        vector<string> ids;
+        for (int i = 10; i < 74; i++) ids.push_back("id=" + std::to_string(i) + "\\d{4} ");
+
+        return {
+            // a plain literal, so the prefilter decides every line on its own
+            { "literal", "logs", { "connection reset" } },
+            // a literal to skip to, then the automaton has to confirm
+            { "log_fields", "logs", { "ERROR \\w+: user=\\w+ id=\\d+" },
+              &StaticRegex<"ERROR \\w+: user=\\w+ id=\\d+">::is_match },
+            { "log_alternation", "logs", { "(timeout|refused|unreachable) \\w+ \\d+ms" },
+              &StaticRegex<"(timeout|refused|unreachable) \\w+ \\d+ms">::is_match },
+            // nothing for the prefilter, every byte goes through the automaton
+            { "no_literal", "logs", { "[aeiou][aeiou]\\w*=" }, &StaticRegex<"[aeiou][aeiou]\\w*=">::is_match },
+            // exponential for a backtracker, linear for us
+            { "nested_star", "a_runs", { "(a|aa)*b" }, &StaticRegex<"(a|aa)*b">::is_match },
+            // 2^21 dfa states, which the lazy dfa can't cache (but it's only 21 positions for the bit-parallel one)
+            { "dfa_blowup", "ab_lines", { "a[ab]{20}$" } },
+            // 60 or so bytes in a class, and a negated one
+            { "large_classes", "words", { "[" + alnum + "._]+@[" + lower + "]+\\.(com|org|net)" } },
+            { "negated_class", "words", { "[^aeiou ]{4}" }, &StaticRegex<"[^aeiou ]{4}">::is_match },
+            { "long_alternation", "words", { join(words, 0, 1000, "|") } },
+            // separate literal patterns, which get aho-corasick
+            { "literal_set", "words", vector<string>(words.begin() + 1000, words.begin() + 3000) },
+            { "regex_set", "logs", ids },
+        };
+    }
+
+    void run_case(const BenchOptions& options, std::ostream& out, const Case& test, const string& corpus) {
+        Context context{ options, out, test, corpus, split(corpus, 1), split(corpus, 64 * 1024), std::nullopt };
+        size_t pattern_bytes = 0;
+        for (const string& pattern : test.patterns) pattern_bytes += pattern.size();
+
+        // compiling: best of reps, allocations from the first go
+        std::optional<Regex> regex;
+        double best = 0;
+        AllocationCount allocations;
+        for (int rep = 0; rep < options.reps; rep++) {
+            regex.reset();
+            AllocationCount before = allocations_so_far();
+            Stopwatch stopwatch;
+            regex.emplace(test.patterns);
+            double seconds = stopwatch.seconds();
+            AllocationCount after = allocations_so_far();
+            if (rep == 0) {
+                best = seconds;
+                allocations = { after.allocations - before.allocations, after.bytes - before.bytes };
+            }
+            else best = std::min(best, seconds);
+        }
+        const NFA& nfa = regex->get_nfa();
+        out << JsonLine().field("record", "compile").field("case", test.name).field("corpus", test.corpus)
+            .field("patterns", static_cast<uint64_t>(test.patterns.size()))
+            .field("pattern_bytes", static_cast<uint64_t>(pattern_bytes))
+            .field("compile_ms", milliseconds(best))
+            .field("allocations", allocations.allocations)
+            .field("allocated_bytes", allocations.bytes)
+            .field("nfa_states", static_cast<uint64_t>(nfa.size()))
+            .field("prefilter", regex->get_prefilter().get_literal())
+            .field("exact_prefilter", regex->get_prefilter().is_exact())
+            .str() << '\n';
+        char summary[64];
+        std::snprintf(summary, sizeof(summary), "%9.3f ms, %u states", milliseconds(best), nfa.size());
+        progress(context, "compile", summary);
+
+        // the engines, fastest first
+        bench_engine(context, "matcher", context.blocks, [&] { return Matcher(*regex); },
+            [](Matcher& matcher, string_view block) {
+                size_t matches = 0;
+                matcher.for_each_match(block, [&](string_view) { matches++; });
+                return matches;
+            }, no_details);
+
+        if (const AhoCorasick* literals = regex->get_literals()) {
+            bench_engine(context, "aho_corasick", context.lines, [&] { return literals; },
+                [](const AhoCorasick* engine, string_view line) -> size_t { return engine->is_match(line); }, no_details);
+        }
+        else skipped(context, "aho_corasick", "not a set of literals");
+
+        if (const BitParallel* bit_parallel = regex->get_bit_parallel()) {
+            bench_engine(context, "bit_parallel", context.lines, [&] { return bit_parallel; },
+                [](const BitParallel* engine, string_view line) -> size_t { return engine->run(line); }, no_details);
+        }
+        else skipped(context, "bit_parallel", "more than 64 positions");
+
+        if (test.static_match) {
+            bench_engine(context, "static_regex", context.lines, [&] { return test.static_match; },
+                [](bool (*static_match)(string_view), string_view line) -> size_t { return static_match(line); }, no_details);
+        }
+        else skipped(context, "static_regex", "pattern isn't fixed at build time");
+
+        try {
+            bench_engine(context, "dense_dfa", context.lines, [&] { return DenseDFA(nfa); },
+                [](DenseDFA& engine, string_view line) -> size_t { return engine.run(line); },
+                [](const DenseDFA& engine, JsonLine& record) {
+                    record.field("dfa_states", static_cast<uint64_t>(engine.state_count()))
+                        .field("unminimized_dfa_states", static_cast<uint64_t>(engine.unminimized_state_count()));
+                });
+        }
+        catch (const std::runtime_error& e) {
+            skipped(context, "dense_dfa", e.what());
+        }
+
+        bench_engine(context, "lazy_dfa", context.lines, [&] { return LazyDFA(nfa); },
+            [](LazyDFA& engine, string_view line) -> size_t { return engine.run(line); },
+            [](const LazyDFA& engine, JsonLine& record) {
+                record.field("cached_states", static_cast<uint64_t>(engine.cached_states()))
+                    .field("flushes", static_cast<uint64_t>(engine.flush_count()))
+                    .field("fell_back_to_nfa", engine.using_nfa());
+            });
+
+        bench_engine(context, "nfa", context.lines, [] { return MatchScratch(); },
+            [&](MatchScratch& scratch, string_view line) -> size_t { return nfa.run(line, scratch); }, no_details);
+    }
+}
+
+int main(int argc, char* argv[]) {
+    BenchOptions options;
+    if (!parse_options(argc, argv, options)) return 2;
+
+    const size_t size = options.size_mib * 1024 * 1024;
+    const vector<string> words = make_words(20000, options.seed);
+    const vector<Case> cases = make_cases(words);
+
+    if (options.list) {
+        for (const Case& test : cases) std::cout << test.name << '\n';
+        return 0;
+    }
+
+    std::ofstream file;
+    if (!options.out_path.empty()) {
+        file.open(options.out_path);
+        if (!file) {
+            std::cerr << "couldn't open output file for writing: " << options.out_path << std::endl;
+            return 1;
+        }
+    }
+    std::ostream& out = options.out_path.empty() ? std::cout : file;
+
+    out << JsonLine().field("record", "run").field("format", static_cast<uint64_t>(FORMAT))
+        .field("corpus_mib", static_cast<uint64_t>(options.size_mib)).field("seed", options.seed)
+        .field("reps", static_cast<uint64_t>(options.reps)).field("max_seconds", options.max_seconds).str() << '\n';
+
+    // only generate the inputs the chosen cases need
+    std::map<string, string> corpora;
+    try {
+        for (const Case& test : cases) {
+            if (string_view(test.name).find(options.case_filter) == string_view::npos) continue;
+            string& corpus = corpora[test.corpus];
+            if (corpus.empty()) {
+                string_view kind = test.corpus;
+                if (kind == "logs") corpus = log_lines(size, options.seed);
+                else if (kind == "a_runs") corpus = a_runs(size, options.seed);
+                else if (kind == "ab_lines") corpus = ab_lines(size, options.seed);
+                else corpus = word_lines(words, size, options.seed);
+            }
+            run_case(options, out, test, corpus);
+            out.flush();
+        }
+    }
+    catch (const std::exception& e) {
+        std::cerr << "error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,76 @@
+#include "measure.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <fstream>
+#include <new>
+#include <string>
+
+#ifndef WINDOWS
+#include <sys/resource.h>
+#endif
+
+namespace {
+    std::atomic<uint64_t> allocation_count{0};
+    std::atomic<uint64_t> allocation_bytes{0};
+
+    void* counted_allocate(std::size_t size) {
+        allocation_count.fetch_add(1, std::memory_order_relaxed);
+        allocation_bytes.fetch_add(size, std::memory_order_relaxed);
+        if (void* p = std::malloc(size == 0 ? 1 : size)) return p;
+        throw std::bad_alloc();
+    }
+
+#ifdef __linux__
+    // a "VmHWM:   1234 kB" style field from /proc/self/status
+    size_t status_field_kib(const std::string& name) {
+        std::ifstream status("/proc/self/status");
+        std::string line;
+        while (std::getline(status, line)) {
+            if (line.compare(0, name.size(), name) == 0) return std::strtoull(line.c_str() + name.size(), nullptr, 10);
+        }
+        return 0;
+    }
+#endif
+}
+
+// the array forms and the nothrow ones all end up in these two
+void* operator new(std::size_t size) { return counted_allocate(size); }
+void* operator new[](std::size_t size) { return counted_allocate(size); }
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+
+AllocationCount allocations_so_far() {
+    return { allocation_count.load(std::memory_order_relaxed), allocation_bytes.load(std::memory_order_relaxed) };
+}
+
+size_t peak_rss_kib() {
+#if defined(__linux__)
+    return status_field_kib("VmHWM:");
+#elif !defined(WINDOWS)
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    // ru_maxrss is in bytes on macOS
+    return static_cast<size_t>(usage.ru_maxrss) / 1024;
+#else
+    return 0;
+#endif
+}
+
+size_t current_rss_kib() {
+#ifdef __linux__
+    return status_field_kib("VmRSS:");
+#else
+    return 0;
+#endif
+}
+
+void reset_peak_rss() {
+#ifdef __linux__
+    // "5" resets the high water mark to what's resident now (linux 4.0 and later, otherwise this does nothing)
+    std::ofstream clear_refs("/proc/self/clear_refs");
+    clear_refs << "5";
+#endif
+}
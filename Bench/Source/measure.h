@@ -0,0 +1,35 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+// Counters for what a benchmark costs besides time.
+// operator new is replaced for the whole bench binary (in measure.cpp) so every allocation Core makes gets counted.
+struct AllocationCount {
+    uint64_t allocations = 0;
+    uint64_t bytes = 0;
+};
+
+// allocations since the program started, take the difference of two of these around what's being measured
+AllocationCount allocations_so_far();
+
+// the most memory the process has had resident (in KiB) since the last reset_peak_rss
+// on linux the high water mark can be reset, so this is per measurement. elsewhere it's since the program
+// started and only ever goes up, and on windows it's always 0
+size_t peak_rss_kib();
+// what's resident right now, in KiB (0 where we can't tell)
+size_t current_rss_kib();
+void reset_peak_rss();
+
+class Stopwatch {
+public:
+    Stopwatch() : start(std::chrono::steady_clock::now()) {}
+
+    double seconds() const {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+private:
+    std::chrono::steady_clock::time_point start;
+};
@@ -14,4 +14,6 @@ group "Core"
 	include "Core/Build-Core.lua"
 group ""
 
-include "App/Build-App.lua"
\ No newline at end of file
+include "App/Build-App.lua"
+include "Bench/Build-Bench.lua"
+include "Tests/Build-Tests.lua"
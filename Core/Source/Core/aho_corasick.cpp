@@ -0,0 +1,141 @@
+#include "aho_corasick.h"
+
+#include <algorithm>
+#include <cstring>
+#include <deque>
+
+AhoCorasick::AhoCorasick(const vector<string>& literals): literal_count(literals.size()) {
+    // every byte that shows up in a literal gets its own class, everything else is class 0
+    for (const string& literal : literals) {
+        for (unsigned char ch : literal) {
+            if (byte_classes[ch] == 0) byte_classes[ch] = class_count++;
+        }
+    }
+
+    // build the trie, with NO_STATE for the edges that aren't there yet
+    auto add_state = [this]() {
+        table.resize(table.size() + class_count, NO_STATE);
+        match_state.push_back(false);
+        outputs.emplace_back();
+        output_link.push_back(NO_STATE);
+        return static_cast<uint32_t>(match_state.size() - 1);
+    };
+    add_state();
+
+    for (uint32_t id = 0; id < literals.size(); id++) {
+        const string& literal = literals[id];
+        if (literal.empty()) continue;
+        first_bytes.insert(literal[0]);
+
+        uint32_t state = 0;
+        for (unsigned char ch : literal) {
+            uint32_t& edge = table[state * class_count + byte_classes[ch]];
+            if (edge == NO_STATE) {
+                uint32_t child = add_state();
+                // add_state can move the table, so look the edge up again
+                table[state * class_count + byte_classes[ch]] = child;
+            }
+            state = table[state * class_count + byte_classes[ch]];
+        }
+        match_state[state] = true;
+        outputs[state].push_back(id);
+    }
+
+    int distinct_first_bytes = 0;
+    for (int c = 0; c < 256; c++) {
+        if (first_bytes.contains(c)) {
+            distinct_first_bytes++;
+            only_first_byte = c;
+        }
+    }
+    if (distinct_first_bytes != 1) only_first_byte = -1;
+
+    // breadth first, so a state's failure state is always finished before the state itself
+    // missing edges get filled in with where the failure state goes, which turns the trie into a dfa
+    vector<uint32_t> failure(match_state.size(), 0);
+    std::deque<uint32_t> queue;
+    for (uint32_t c = 0; c < class_count; c++) {
+        uint32_t& edge = table[c];
+        if (edge == NO_STATE) {
+            edge = 0;
+        }
+        else {
+            failure[edge] = 0;
+            queue.push_back(edge);
+        }
+    }
+    while (!queue.empty()) {
+        uint32_t state = queue.front();
+        queue.pop_front();
+        uint32_t fail = failure[state];
+        if (match_state[fail]) match_state[state] = true;
+        output_link[state] = outputs[fail].empty() ? output_link[fail] : fail;
+
+        for (uint32_t c = 0; c < class_count; c++) {
+            uint32_t& edge = table[state * class_count + c];
+            if (edge == NO_STATE) {
+                edge = table[fail * class_count + c];
+            }
+            else {
+                failure[edge] = table[fail * class_count + c];
+                queue.push_back(edge);
+            }
+        }
+    }
+}
+
+size_t AhoCorasick::skip_to_start(std::string_view haystack, size_t from) const {
+    if (only_first_byte >= 0) {
+        const void* hit = std::memchr(haystack.data() + from, only_first_byte, haystack.size() - from);
+        return hit == nullptr ? haystack.size() : static_cast<const char*>(hit) - haystack.data();
+    }
+    while (from < haystack.size() && !first_bytes.contains(haystack[from])) from++;
+    return from;
+}
+
+size_t AhoCorasick::find(std::string_view haystack, size_t from) const {
+    uint32_t state = 0;
+    return scan(state, haystack, from);
+}
+
+bool AhoCorasick::resume(uint32_t& state, std::string_view piece) const {
+    return scan(state, piece, 0) != std::string_view::npos;
+}
+
+size_t AhoCorasick::scan(uint32_t& state, std::string_view haystack, size_t from) const {
+    uint32_t current = state;
+    size_t i = from;
+    while (i < haystack.size()) {
+        if (current == 0) {
+            i = skip_to_start(haystack, i);
+            if (i == haystack.size()) break;
+        }
+        current = next(current, haystack[i]);
+        i++;
+        if (match_state[current]) {
+            state = current;
+            return i;
+        }
+    }
+    state = current;
+    return std::string_view::npos;
+}
+
+void AhoCorasick::match_patterns(std::string_view line, vector<uint32_t>& ids, MatchScratch& scratch) const {
+    scratch.reserve(0, literal_count);
+    vector<char>& matched = scratch.matched;
+    std::fill(matched.begin(), matched.begin() + literal_count, 0);
+    uint32_t state = 0;
+    for (unsigned char ch : line) {
+        state = next(state, ch);
+        // walk down the output links to pick up every literal that ends here
+        for (uint32_t s = outputs[state].empty() ? output_link[state] : state; s != NO_STATE; s = output_link[s]) {
+            for (uint32_t id : outputs[s]) matched[id] = true;
+        }
+    }
+
+    ids.clear();
+    for (uint32_t i = 0; i < literal_count; i++) {
+        if (matched[i]) ids.push_back(i);
+    }
+}
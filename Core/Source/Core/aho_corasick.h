@@ -0,0 +1,59 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "byte_set.h"
+#include "match_scratch.h"
+
+using std::vector, std::string;
+
+// Aho-Corasick automaton for a set of plain literals, used instead of the NFA when every pattern is one.
+// The failure links are folded into a dense transition table, so matching is one lookup per byte no matter
+// how many literals there are, and the table is indexed by byte class (bytes that aren't in any literal
+// all share one class) to keep the rows short.
+class AhoCorasick {
+public:
+    explicit AhoCorasick(const vector<string>& literals);
+    ~AhoCorasick() = default;
+
+    // position just past the end of the first literal found in haystack at or after from, or npos
+    size_t find(std::string_view haystack, size_t from = 0) const;
+    bool is_match(std::string_view line) const { return find(line) != std::string_view::npos; }
+
+    // for a line that comes in pieces (StreamMatcher): state starts at 0, and is where the automaton got to in the pieces
+    // before. true if a literal ends in piece, and then the rest of the line doesn't matter
+    bool resume(uint32_t& state, std::string_view piece) const;
+
+    // fills ids (in ascending order) with every literal that appears in line
+    void match_patterns(std::string_view line, vector<uint32_t>& ids, MatchScratch& scratch) const;
+
+private:
+    static constexpr uint32_t NO_STATE = 0xFFFFFFFF;
+
+    std::array<uint8_t, 256> byte_classes{};
+    uint32_t class_count = 1;
+    // state * class_count + byte class -> next state. state 0 is the root
+    vector<uint32_t> table;
+    // whether a literal ends at each state (the state's own, or one on its failure chain)
+    vector<uint8_t> match_state;
+    // ids of the literals that end exactly at each state, and the next state down the failure chain that has some
+    vector<vector<uint32_t>> outputs;
+    vector<uint32_t> output_link;
+    uint32_t literal_count = 0;
+
+    // while we're at the root we can skip ahead to the next byte that starts a literal
+    ByteSet first_bytes;
+    int only_first_byte = -1;
+
+    uint32_t next(uint32_t state, unsigned char ch) const {
+        return table[state * class_count + byte_classes[ch]];
+    }
+    size_t skip_to_start(std::string_view haystack, size_t from) const;
+    // find, starting from state (and leaving it wherever the automaton got to)
+    size_t scan(uint32_t& state, std::string_view haystack, size_t from) const;
+};
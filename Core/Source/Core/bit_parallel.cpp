@@ -0,0 +1,102 @@
+#include "bit_parallel.h"
+
+namespace {
+    // the byte consuming states, in program order, which is left to right in the pattern
+    vector<StateId> positions_of(const NFA& nfa) {
+        vector<StateId> positions;
+        for (StateId id = 0; id < nfa.size(); id++) {
+            if (nfa.inst(id).consumes()) positions.push_back(id);
+        }
+        return positions;
+    }
+}
+
+bool BitParallel::fits(const NFA& nfa) {
+    uint32_t count = 0;
+    for (StateId id = 0; id < nfa.size(); id++) {
+        if (nfa.inst(id).consumes() && ++count > MAX_POSITIONS) return false;
+    }
+    return true;
+}
+
+BitParallel::BitParallel(const NFA& nfa) {
+    vector<StateId> positions = positions_of(nfa);
+    vector<int> bit(nfa.size(), -1);
+    for (size_t p = 0; p < positions.size(); p++) bit[positions[p]] = p;
+
+    // a closure is a set of positions, plus whether it reaches a Match (that counts now, or only at the end)
+    auto closure_bits = [&](StateId id, bool& now, bool& at_end) {
+        uint64_t set = 0;
+        now = at_end = false;
+        if (id == NO_STATE) return set;
+        for (StateId state : nfa.closure(id)) {
+            const Inst& inst = nfa.inst(state);
+            if (inst.op == Inst::OP::Match) {
+                at_end = true;
+                if (!inst.end_anchored()) now = true;
+            }
+            else {
+                set |= uint64_t{1} << bit[state];
+            }
+        }
+        return set;
+    };
+
+    start_positions = closure_bits(nfa.start_state(), start_match_now, start_match_at_end);
+    restart_positions = closure_bits(nfa.restart_state(), restart_match_now, restart_match_at_end);
+
+    vector<uint64_t> rest(positions.size(), 0);
+    for (size_t p = 0; p < positions.size(); p++) {
+        const Inst& inst = nfa.inst(positions[p]);
+        for (int c = 0; c < 256; c++) {
+            if (nfa.matches(inst, c)) byte_masks[c] |= uint64_t{1} << p;
+        }
+
+        bool now, at_end;
+        uint64_t follow_set = closure_bits(inst.out, now, at_end);
+        if (now) match_now |= uint64_t{1} << p;
+        if (at_end) match_at_end |= uint64_t{1} << p;
+
+        // peel off the next position, which the shift takes care of
+        uint64_t next_bit = p + 1 < MAX_POSITIONS ? uint64_t{1} << (p + 1) : 0;
+        if (follow_set & next_bit) {
+            shift_mask |= uint64_t{1} << p;
+            follow_set &= ~next_bit;
+        }
+        rest[p] = follow_set;
+        if (follow_set != 0) rest_mask |= uint64_t{1} << p;
+    }
+
+    // one table per 8 positions that have somewhere else to go
+    for (uint8_t chunk = 0; chunk * 8 < positions.size(); chunk++) {
+        if (((rest_mask >> (chunk * 8)) & 0xFF) == 0) continue;
+        rest_chunks.push_back(chunk);
+        size_t table = rest_tables.size();
+        rest_tables.resize(table + 256, 0);
+        for (int byte = 0; byte < 256; byte++) {
+            for (int i = 0; i < 8; i++) {
+                size_t p = chunk * 8 + i;
+                if ((byte >> i & 1) && p < positions.size()) rest_tables[table + byte] |= rest[p];
+            }
+        }
+    }
+}
+
+bool BitParallel::run(std::string_view input) const {
+    // this follows NFA::run step for step, with the set of states as a word
+    if (start_match_now) return true;
+    if (input.empty()) return start_match_at_end;
+    // every byte adds the restart states back in, so a Match in there is reached after the first byte
+    if (restart_match_now) return true;
+
+    uint64_t current = start_positions;
+    uint64_t consumed = 0;
+    for (const char c : input) {
+        consumed = current & byte_masks[static_cast<unsigned char>(c)];
+        if (consumed & match_now) return true;
+        current = follow(consumed) | restart_positions;
+    }
+
+    // at the end of the line any match counts
+    return (consumed & match_at_end) != 0 || restart_match_at_end;
+}
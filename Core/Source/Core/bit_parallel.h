@@ -0,0 +1,62 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+#include "nfa.h"
+
+using std::vector;
+
+// Bit-parallel simulation of the position (Glushkov) automaton, for patterns with at most 64 positions.
+// The positions are the NFA's byte consuming states, so the set of states we're in is one 64 bit word:
+// a step is an and with the byte's mask and a lookup of where the surviving positions can go next.
+// Most positions just lead to the one after them, which is a shift (Shift-And), and only the rest
+// (loops, alternations) need the follow tables, one lookup per 8 positions that have anything else.
+// Unlike the lazy dfa there's no cache to fill (or flush), so it's as fast on the first line as on the millionth.
+class BitParallel {
+public:
+    static constexpr uint32_t MAX_POSITIONS = 64;
+
+    // true if nfa has few enough positions for one word
+    static bool fits(const NFA& nfa);
+
+    explicit BitParallel(const NFA& nfa);
+    ~BitParallel() = default;
+
+    // same answer as NFA::run
+    bool run(std::string_view input) const;
+
+private:
+    // positions that consume each byte
+    std::array<uint64_t, 256> byte_masks{};
+    // positions whose follow set includes the next position, and the ones that can go anywhere else as well
+    uint64_t shift_mask = 0;
+    uint64_t rest_mask = 0;
+    // rest_chunks[i] is which 8 positions rest_tables[i * 256 + byte] covers, and the table is the union of
+    // everywhere other than the next position those positions can go
+    vector<uint8_t> rest_chunks;
+    vector<uint64_t> rest_tables;
+
+    // the positions we can be in before the first byte, and the ones the unanchored patterns add at every later byte
+    uint64_t start_positions = 0;
+    uint64_t restart_positions = 0;
+    // positions right before a Match, one that counts anywhere and one that only counts at the end of the line
+    uint64_t match_now = 0;
+    uint64_t match_at_end = 0;
+    // the same, for Matches we can reach without consuming anything
+    bool start_match_now = false, start_match_at_end = false;
+    bool restart_match_now = false, restart_match_at_end = false;
+
+    uint64_t follow(uint64_t positions) const {
+        uint64_t next = (positions & shift_mask) << 1;
+        uint64_t rest = positions & rest_mask;
+        if (rest != 0) {
+            for (size_t i = 0; i < rest_chunks.size(); i++) {
+                next |= rest_tables[i * 256 + ((rest >> (rest_chunks[i] * 8)) & 0xFF)];
+            }
+        }
+        return next;
+    }
+};
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+// A partition of the 256 byte values into classes that every transition of an automaton treats the same,
+// so transition tables can have a column per class instead of per byte.
+// (constexpr, so StaticRegex can work its classes out at compile time)
+class ByteClasses {
+public:
+    // every byte in one class
+    constexpr ByteClasses() = default;
+
+    // split every class into the bytes that are in accepts and the ones that aren't
+    template <typename Accepts>
+    constexpr void refine(Accepts&& accepts) {
+        // old class -> new class, for the part of it that accepts lets through
+        std::array<int, 256> split{};
+        split.fill(-1);
+        uint32_t next = count;
+        for (int c = 0; c < 256; c++) {
+            if (!accepts(static_cast<unsigned char>(c))) continue;
+            if (split[classes[c]] < 0) split[classes[c]] = next++;
+            classes[c] = split[classes[c]];
+        }
+        renumber();
+    }
+
+    constexpr uint8_t get(unsigned char ch) const { return lookup[ch]; }
+    constexpr uint32_t size() const { return count; }
+    // the first byte in each class, which can stand in for the whole class
+    constexpr unsigned char representative(uint32_t id) const {
+        int c = 0;
+        while (classes[c] != id) c++;
+        return c;
+    }
+    constexpr const std::array<uint8_t, 256>& map() const { return lookup; }
+
+private:
+    // a refine can briefly need ids up to 511, which is why these aren't uint8_t
+    std::array<uint16_t, 256> classes{};
+    // the same thing packed into bytes, for the matching loops
+    std::array<uint8_t, 256> lookup{};
+    uint32_t count = 1;
+
+    // number the classes 0, 1, ... in order of their first byte
+    constexpr void renumber() {
+        std::array<int, 512> ids{};
+        ids.fill(-1);
+        count = 0;
+        for (int c = 0; c < 256; c++) {
+            if (ids[classes[c]] < 0) ids[classes[c]] = count++;
+            classes[c] = ids[classes[c]];
+            lookup[c] = classes[c];
+        }
+    }
+};
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+
+// a set of bytes stored as a 256-bit bitmap, so membership is a shift and a mask
+// (all constexpr, so the parser can build them at compile time for StaticRegex)
+struct ByteSet {
+    std::array<uint64_t, 4> bits{};
+
+    constexpr bool contains(unsigned char ch) const {
+        return (bits[ch >> 6] >> (ch & 63)) & 1;
+    }
+
+    constexpr void insert(unsigned char ch) {
+        bits[ch >> 6] |= uint64_t(1) << (ch & 63);
+    }
+
+    constexpr void erase(unsigned char ch) {
+        bits[ch >> 6] &= ~(uint64_t(1) << (ch & 63));
+    }
+
+    constexpr void insert_all() {
+        bits.fill(~uint64_t(0));
+    }
+
+    constexpr int count() const {
+        int total = 0;
+        for (uint64_t word : bits) total += std::popcount(word);
+        return total;
+    }
+
+    constexpr bool operator==(const ByteSet& other) const = default;
+};
+
+// for keeping sets of ByteSets in hash maps
+struct ByteSetHash {
+    size_t operator()(const ByteSet& set) const {
+        size_t hash = 0;
+        for (uint64_t word : set.bits) hash ^= word + 0x9e3779b97f4a7c15ULL + (hash << 6) + (hash >> 2);
+        return hash;
+    }
+};
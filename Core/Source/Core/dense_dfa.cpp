@@ -0,0 +1,335 @@
+#include "dense_dfa.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <unordered_map>
+
+#include "sparse_set.h"
+
+namespace {
+    constexpr char MAGIC[8] = {'G', 'R', 'A', 'P', 'E', 'D', 'F', 'A'};
+    // bump this whenever the layout (or what the tags mean) changes
+    constexpr uint32_t VERSION = 2;
+    // reads back as something else on a machine with the other byte order
+    constexpr uint32_t ENDIAN_MARKER = 0x01020304;
+
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t endian_marker;
+        uint32_t state_count;
+        uint32_t class_count;
+        uint32_t start;
+        uint32_t literal_size;
+        uint32_t literal_exact;
+        // FNV-1a of everything after the header
+        uint64_t checksum;
+    };
+    // keeps the table after it 8 byte aligned
+    static_assert(sizeof(Header) % 8 == 0);
+
+    uint64_t fnv1a(std::string_view bytes) {
+        uint64_t hash = 0xcbf29ce484222325ULL;
+        for (unsigned char byte : bytes) {
+            hash ^= byte;
+            hash *= 0x100000001b3ULL;
+        }
+        return hash;
+    }
+
+    struct StateSetHash {
+        size_t operator()(const vector<StateId>& set) const {
+            size_t hash = set.size();
+            for (StateId id : set) {
+                hash ^= id + 0x9e3779b97f4a7c15ULL + (hash << 6) + (hash >> 2);
+            }
+            return hash;
+        }
+    };
+
+    // the subset construction, before minimizing. ids are untagged, and rows have a column per byte class
+    struct Subsets {
+        uint32_t stride = 0;
+        vector<uint32_t> table;
+        // has a Match that counts right away, or one that counts at the end of the line
+        vector<uint8_t> match_now;
+        vector<uint8_t> match_at_end;
+        uint32_t start = 0;
+
+        uint32_t size() const { return match_now.size(); }
+    };
+
+    Subsets determinize(const NFA& nfa, uint32_t max_states) {
+        // the same steps as LazyDFA::compute_next, just for every state and byte up front
+        Subsets dfa;
+        const ByteClasses& classes = nfa.equivalence_classes();
+        dfa.stride = classes.size();
+        vector<vector<StateId>> sets;
+        std::unordered_map<vector<StateId>, uint32_t, StateSetHash> ids;
+        SparseSet threads(nfa.size());
+
+        auto add_state = [&]() {
+            vector<StateId> set(threads.begin(), threads.end());
+            std::sort(set.begin(), set.end());
+            auto existing = ids.find(set);
+            if (existing != ids.end()) return existing->second;
+            if (sets.size() >= max_states) {
+                throw std::runtime_error("pattern needs more than " + std::to_string(max_states) + " dfa states, which is too many to build ahead of time");
+            }
+
+            bool now = false, at_end = false;
+            for (StateId state : set) {
+                const Inst& inst = nfa.inst(state);
+                if (inst.op != Inst::OP::Match) continue;
+                at_end = true;
+                if (!inst.end_anchored()) now = true;
+            }
+            uint32_t id = sets.size();
+            dfa.match_now.push_back(now);
+            dfa.match_at_end.push_back(at_end);
+            dfa.table.resize(dfa.table.size() + dfa.stride, id);
+            ids.emplace(set, id);
+            sets.push_back(std::move(set));
+            return id;
+        };
+
+        if (nfa.start_state() != NO_STATE) nfa.add_closure(threads, nfa.start_state());
+        dfa.start = add_state();
+
+        for (uint32_t id = 0; id < sets.size(); id++) {
+            // run stops as soon as it reaches one of these, so their transitions can just stay on themselves
+            if (dfa.match_now[id]) continue;
+            // add_state can move sets around, so work from a copy
+            vector<StateId> set = sets[id];
+            for (uint32_t cls = 0; cls < dfa.stride; cls++) {
+                // any byte in the class gives the same set
+                const unsigned char ch = classes.representative(cls);
+                threads.clear();
+                for (StateId state : set) {
+                    const Inst& inst = nfa.inst(state);
+                    if (nfa.matches(inst, ch)) nfa.add_closure(threads, inst.out);
+                }
+                if (nfa.restart_state() != NO_STATE) nfa.add_closure(threads, nfa.restart_state());
+                uint32_t next = add_state();
+                dfa.table[id * dfa.stride + cls] = next;
+            }
+        }
+        return dfa;
+    }
+
+    // Hopcroft's algorithm: start with the states split by what kind of match they have, and keep splitting
+    // blocks whose states go to different blocks on some byte. the blocks left are the minimal dfa's states
+    // returns the block of every state
+    vector<uint32_t> minimize(const Subsets& dfa, uint32_t& block_count) {
+        const uint32_t n = dfa.size();
+        const uint32_t k = dfa.stride;
+
+        // predecessors[pred_begin[t * k + cls] ...] are the states that go to t on cls
+        vector<uint32_t> pred_begin(n * k + 1, 0);
+        for (uint32_t s = 0; s < n; s++) {
+            for (uint32_t cls = 0; cls < k; cls++) pred_begin[dfa.table[s * k + cls] * k + cls + 1]++;
+        }
+        for (size_t i = 1; i < pred_begin.size(); i++) pred_begin[i] += pred_begin[i - 1];
+        vector<uint32_t> predecessors(n * k);
+        {
+            vector<uint32_t> fill(pred_begin.begin(), pred_begin.end() - 1);
+            for (uint32_t s = 0; s < n; s++) {
+                for (uint32_t cls = 0; cls < k; cls++) predecessors[fill[dfa.table[s * k + cls] * k + cls]++] = s;
+            }
+        }
+
+        // each block is a range of elements, with its marked states moved to the front while splitting
+        struct Block {
+            uint32_t begin, end, marked;
+        };
+        vector<Block> blocks;
+        vector<uint32_t> elements(n), location(n), block_of(n);
+
+        // the initial split: no match, match at the end of the line, match right away
+        auto kind = [&](uint32_t s) { return dfa.match_now[s] ? 2 : dfa.match_at_end[s] ? 1 : 0; };
+        uint32_t next_element = 0;
+        for (int k = 0; k < 3; k++) {
+            uint32_t begin = next_element;
+            for (uint32_t s = 0; s < n; s++) {
+                if (kind(s) != k) continue;
+                elements[next_element] = s;
+                location[s] = next_element++;
+                block_of[s] = blocks.size();
+            }
+            if (next_element > begin) blocks.push_back({begin, next_element, 0});
+        }
+
+        vector<uint32_t> worklist;
+        vector<uint8_t> in_worklist(blocks.size(), true);
+        for (uint32_t b = 0; b < blocks.size(); b++) worklist.push_back(b);
+
+        vector<uint32_t> splitter, touched;
+        while (!worklist.empty()) {
+            uint32_t b = worklist.back();
+            worklist.pop_back();
+            in_worklist[b] = false;
+            // splitting with the states as they are now is fine even if b itself gets split below
+            splitter.assign(elements.begin() + blocks[b].begin, elements.begin() + blocks[b].end);
+
+            for (uint32_t cls = 0; cls < k; cls++) {
+                touched.clear();
+                for (uint32_t t : splitter) {
+                    for (uint32_t i = pred_begin[t * k + cls]; i < pred_begin[t * k + cls + 1]; i++) {
+                        uint32_t s = predecessors[i];
+                        Block& block = blocks[block_of[s]];
+                        if (block.marked == 0) touched.push_back(block_of[s]);
+                        // swap s into the marked part at the front of its block
+                        uint32_t target = block.begin + block.marked++;
+                        uint32_t other = elements[target];
+                        std::swap(elements[location[s]], elements[target]);
+                        location[other] = location[s];
+                        location[s] = target;
+                    }
+                }
+
+                for (uint32_t y : touched) {
+                    Block& block = blocks[y];
+                    uint32_t marked = block.marked;
+                    block.marked = 0;
+                    if (marked == block.end - block.begin) continue;
+
+                    // the marked states become a new block
+                    uint32_t split = blocks.size();
+                    blocks.push_back({block.begin, block.begin + marked, 0});
+                    blocks[y].begin += marked;
+                    for (uint32_t i = blocks[split].begin; i < blocks[split].end; i++) block_of[elements[i]] = split;
+
+                    // if y is still waiting, both halves need to be, otherwise only the smaller one does
+                    in_worklist.push_back(false);
+                    if (in_worklist[y]) {
+                        worklist.push_back(split);
+                        in_worklist[split] = true;
+                    }
+                    else {
+                        uint32_t smaller = marked <= blocks[y].end - blocks[y].begin ? split : y;
+                        worklist.push_back(smaller);
+                        in_worklist[smaller] = true;
+                    }
+                }
+            }
+        }
+
+        block_count = blocks.size();
+        return block_of;
+    }
+}
+
+DenseDFA::DenseDFA(const NFA& nfa, uint32_t max_states) {
+    Subsets dfa = determinize(nfa, max_states);
+    unminimized_states = dfa.size();
+    stride = dfa.stride;
+    owned_classes.assign(nfa.equivalence_classes().map().begin(), nfa.equivalence_classes().map().end());
+
+    uint32_t block_count = 0;
+    vector<uint32_t> block_of = minimize(dfa, block_count);
+    states = block_count;
+
+    // every state in a block behaves the same, so any of them can stand in for it
+    vector<uint32_t> representative(block_count);
+    for (uint32_t s = 0; s < dfa.size(); s++) representative[block_of[s]] = s;
+
+    vector<uint32_t> tags(block_count, 0);
+    for (uint32_t b = 0; b < block_count; b++) {
+        uint32_t s = representative[b];
+        if (dfa.match_at_end[s]) tags[b] |= END_MATCH_TAG;
+        if (dfa.match_now[s]) {
+            tags[b] |= MATCH_TAG;
+            continue;
+        }
+        // a state that never matches and never leaves is dead
+        bool dead = !dfa.match_at_end[s];
+        for (uint32_t cls = 0; dead && cls < stride; cls++) {
+            if (block_of[dfa.table[s * stride + cls]] != b) dead = false;
+        }
+        if (dead) tags[b] |= DEAD_TAG;
+    }
+
+    // ids are where the state's row starts, so stepping doesn't need a multiply
+    if (size_t{block_count} * stride > ID_MASK) throw std::runtime_error("dfa table is too big to build ahead of time");
+    auto id = [&](uint32_t block) { return block * stride | tags[block]; };
+    owned_table.resize(size_t{block_count} * stride);
+    for (uint32_t b = 0; b < block_count; b++) {
+        uint32_t s = representative[b];
+        for (uint32_t cls = 0; cls < stride; cls++) {
+            owned_table[b * stride + cls] = id(block_of[dfa.table[s * stride + cls]]);
+        }
+    }
+    start = id(block_of[dfa.start]);
+
+    classes = owned_classes.data();
+    table = owned_table.data();
+}
+
+string DenseDFA::serialize(const Prefilter& prefilter) const {
+    const string& literal = prefilter.get_literal();
+    string body;
+    body.append(reinterpret_cast<const char*>(classes), 256);
+    body.append(reinterpret_cast<const char*>(table), size_t{states} * stride * sizeof(uint32_t));
+    body.append(literal);
+
+    Header header{};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.endian_marker = ENDIAN_MARKER;
+    header.state_count = states;
+    header.class_count = stride;
+    header.start = start;
+    header.literal_size = literal.size();
+    header.literal_exact = prefilter.is_exact();
+    header.checksum = fnv1a(body);
+
+    string bytes(reinterpret_cast<const char*>(&header), sizeof(header));
+    return bytes + body;
+}
+
+DenseDFA DenseDFA::load(std::string_view bytes, Prefilter& prefilter) {
+    Header header;
+    if (bytes.size() < sizeof(header)) throw std::runtime_error("not a grape dfa file: too short");
+    std::memcpy(&header, bytes.data(), sizeof(header));
+    if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0) throw std::runtime_error("not a grape dfa file");
+    if (header.version != VERSION) throw std::runtime_error("dfa file was saved by a different version of grape");
+    if (header.endian_marker != ENDIAN_MARKER) throw std::runtime_error("dfa file was saved on a machine with a different byte order");
+
+    size_t table_size = size_t{header.state_count} * header.class_count * sizeof(uint32_t);
+    std::string_view body = bytes.substr(sizeof(header));
+    if (header.state_count == 0 || header.class_count == 0 || header.class_count > 256
+        || body.size() != 256 + table_size + header.literal_size) {
+        throw std::runtime_error("dfa file is the wrong size");
+    }
+    if (fnv1a(body) != header.checksum) throw std::runtime_error("dfa file is corrupt (checksum mismatch)");
+    // the table gets read in place, so it has to be aligned (mmap always is)
+    if (reinterpret_cast<uintptr_t>(body.data()) % alignof(uint32_t) != 0) throw std::runtime_error("dfa file isn't aligned in memory");
+
+    // the checksum only catches accidents, so check everything run() indexes with is in range before trusting it:
+    // every state id has to be the start of a row (the tags can be on it, but nothing above them)
+    const uint8_t* classes = reinterpret_cast<const uint8_t*>(body.data());
+    const uint32_t* table = reinterpret_cast<const uint32_t*>(body.data() + 256);
+    const size_t table_entries = size_t{header.state_count} * header.class_count;
+    if (table_entries > ID_MASK) throw std::runtime_error("dfa file is corrupt (too many states)");
+    auto valid_state = [&](uint32_t id) {
+        uint32_t offset = id & ID_MASK;
+        return (id & ~(MATCH_TAG | DEAD_TAG | END_MATCH_TAG | ID_MASK)) == 0 && offset < table_entries && offset % header.class_count == 0;
+    };
+    if (!valid_state(header.start)) throw std::runtime_error("dfa file is corrupt (bad start state)");
+    for (size_t b = 0; b < 256; b++) {
+        if (classes[b] >= header.class_count) throw std::runtime_error("dfa file is corrupt (bad byte class)");
+    }
+    for (size_t i = 0; i < table_entries; i++) {
+        if (!valid_state(table[i])) throw std::runtime_error("dfa file is corrupt (bad transition)");
+    }
+
+    DenseDFA dfa;
+    dfa.states = dfa.unminimized_states = header.state_count;
+    dfa.stride = header.class_count;
+    dfa.start = header.start;
+    dfa.classes = classes;
+    dfa.table = table;
+    prefilter = Prefilter(string(body.substr(256 + table_size)), header.literal_exact != 0);
+    return dfa;
+}
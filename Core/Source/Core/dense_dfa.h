@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "nfa.h"
+#include "prefilter.h"
+
+using std::vector, std::string;
+
+// A DFA built ahead of time: the whole subset construction up front, then Hopcroft's algorithm to merge
+// the states that behave the same. It can be written out with serialize and used again with load, which
+// checks the header and points straight into the bytes it's given (a memory mapped file), so a saved
+// pattern starts matching without parsing, compiling or determinizing anything.
+//
+// File layout (native byte order, the header says which):
+//   Header
+//   uint8_t  classes[256]                    the byte class of every byte
+//   uint32_t table[state_count * class_count] tagged state ids (row offsets), like LazyDFA's table
+//   char     literal[literal_size]           the prefilter's literal
+class DenseDFA {
+public:
+    // building gives up (with std::runtime_error) past this many states, a bigger table isn't worth saving
+    static constexpr uint32_t DEFAULT_MAX_STATES = 10000;
+
+    explicit DenseDFA(const NFA& nfa, uint32_t max_states = DEFAULT_MAX_STATES);
+    ~DenseDFA() = default;
+
+    DenseDFA(const DenseDFA&) = delete;
+    DenseDFA& operator=(const DenseDFA&) = delete;
+    DenseDFA(DenseDFA&&) = default;
+    DenseDFA& operator=(DenseDFA&&) = default;
+
+    // the bytes of a file that load can read back, with the prefilter that goes with the pattern
+    string serialize(const Prefilter& prefilter) const;
+    // check bytes and use them in place, they have to outlive the dfa (and start 8 byte aligned)
+    // throws std::runtime_error if they aren't a dfa this version of grape saved, or any state id or byte class in them is out of range
+    static DenseDFA load(std::string_view bytes, Prefilter& prefilter);
+
+    // same answer as NFA::run
+    bool run(std::string_view input) const {
+        uint32_t current = start;
+        if (current & MATCH_TAG) return true;
+        if (current & DEAD_TAG) return false;
+        for (const char c : input) {
+            current = table[(current & ID_MASK) + classes[static_cast<unsigned char>(c)]];
+            if (current >= DEAD_TAG) return (current & MATCH_TAG) != 0;
+        }
+        return (current & END_MATCH_TAG) != 0;
+    }
+
+    // run, for a line that comes in pieces (StreamMatcher): state starts as line_start(), resume steps it over each
+    // piece (true once the rest of the line can't change the answer) and end_line reads the answer off it
+    uint32_t line_start() const { return start; }
+    bool resume(uint32_t& state, std::string_view piece) const {
+        uint32_t current = state;
+        if (current >= DEAD_TAG) return true;
+        for (const char c : piece) {
+            current = table[(current & ID_MASK) + classes[static_cast<unsigned char>(c)]];
+            if (current >= DEAD_TAG) break;
+        }
+        state = current;
+        return current >= DEAD_TAG;
+    }
+    static bool end_line(uint32_t state) { return (state & END_MATCH_TAG) != 0; }
+
+    uint32_t state_count() const { return states; }
+    // how many states the subset construction made before minimizing
+    uint32_t unminimized_state_count() const { return unminimized_states; }
+
+private:
+    static constexpr uint32_t MATCH_TAG = 1u << 30;
+    static constexpr uint32_t DEAD_TAG = 1u << 29;
+    static constexpr uint32_t END_MATCH_TAG = 1u << 28;
+    static constexpr uint32_t ID_MASK = END_MATCH_TAG - 1;
+
+    DenseDFA() = default;
+
+    // these point into the owned members, or into the bytes we were loaded from
+    const uint8_t* classes = nullptr;
+    const uint32_t* table = nullptr;
+    uint32_t start = 0;
+    uint32_t states = 0;
+    // row length of the table, the number of byte classes
+    uint32_t stride = 0;
+    uint32_t unminimized_states = 0;
+
+    vector<uint8_t> owned_classes;
+    vector<uint32_t> owned_table;
+};
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+
+// states are just indexes into the NFA's program
+using StateId = uint32_t;
+constexpr StateId NO_STATE = 0xFFFFFFFF;
+
+// One instruction of a compiled pattern (Pike VM style). The whole NFA is a flat array of these,
+// so simulating it walks a contiguous block of memory instead of chasing pointers around the heap.
+struct Inst {
+    // Char, ByteRange and Class consume a byte, Split, Jmp and Save are epsilon transitions, Match is the accept state
+    // Save is a Jmp that also records the position in a capture slot, which only the Pike VM does anything with
+    enum class OP : uint8_t { Char, ByteRange, Class, Split, Jmp, Save, Match };
+    OP op = OP::Match;
+
+    // payloads
+    unsigned char lo = 0; // the byte for Char, first byte for ByteRange, 1 for a Match that only counts at the end of the line
+    unsigned char hi = 0; // last byte for ByteRange (same as lo for Char)
+    StateId out = NO_STATE; // next state (first branch for Split)
+    StateId out1 = NO_STATE; // second branch for Split, index into the NFA's classes for Class, slot for Save, pattern id for Match
+
+    static Inst byte(unsigned char ch, StateId out) { return {OP::Char, ch, ch, out, NO_STATE}; }
+    static Inst range(unsigned char lo, unsigned char hi, StateId out) { return {OP::ByteRange, lo, hi, out, NO_STATE}; }
+    static Inst byte_class(uint32_t class_index, StateId out) { return {OP::Class, 0, 0, out, class_index}; }
+    static Inst split(StateId out, StateId out1) { return {OP::Split, 0, 0, out, out1}; }
+    static Inst jmp(StateId out) { return {OP::Jmp, 0, 0, out, NO_STATE}; }
+    static Inst save(uint32_t slot, StateId out) { return {OP::Save, 0, 0, out, slot}; }
+    static Inst match(uint32_t pattern, bool end_anchored) { return {OP::Match, end_anchored, 0, NO_STATE, pattern}; }
+
+    bool is_epsilon() const { return op == OP::Split || op == OP::Jmp || op == OP::Save; }
+    bool consumes() const { return op == OP::Char || op == OP::ByteRange || op == OP::Class; }
+
+    // for Match
+    uint32_t pattern() const { return out1; }
+    bool end_anchored() const { return lo != 0; }
+    // for Save
+    uint32_t slot() const { return out1; }
+};
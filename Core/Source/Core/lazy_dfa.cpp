@@ -0,0 +1,245 @@
+#include "lazy_dfa.h"
+
+#include <algorithm>
+
+LazyDFA::LazyDFA(const NFA& nfa, LazyDFAConfig config, bool anchored):
+    nfa(nfa), config(config), anchored(anchored), classes(nfa.equivalence_classes()), stride(classes.size()), threads(nfa.size()) {
+    flush();
+    // the first flush doesn't count towards anything
+    flushes = 0;
+}
+
+bool LazyDFA::run(std::string_view input_string) {
+    if (fell_back) return nfa.run(input_string, fallback_scratch);
+    bytes_since_flush += input_string.size();
+
+    uint32_t current = start_state;
+    if (current & MATCH_TAG) return true;
+    if (current & DEAD_TAG) return false;
+
+    // locals, so the hot loop doesn't reload them through this every byte
+    const uint8_t* byte_class = classes.map().data();
+    const uint32_t* rows = table.data();
+    const char* const begin = input_string.data();
+    const char* const end = begin + input_string.size();
+    for (const char* p = begin; p != end; ++p) {
+        const unsigned char ch = *p;
+        uint32_t next = rows[(current & ID_MASK) + byte_class[ch]];
+        // untagged ids are always below DEAD_TAG, so anything else drops into the slow path
+        if (next >= DEAD_TAG) {
+            if (next == UNKNOWN) {
+                next = compute_next(current, ch);
+                // the cache thrashed too often, redo this line with the nfa
+                if (fell_back) {
+                    steps += p - begin + 1;
+                    return nfa.run(input_string, fallback_scratch);
+                }
+                // adding a state can move the table
+                rows = table.data();
+            }
+            if (next >= DEAD_TAG) {
+                // the steps only get counted on the way out, so the hot loop doesn't have to
+                steps += p - begin + 1;
+                return (next & MATCH_TAG) != 0;
+            }
+        }
+        current = next;
+    }
+    steps += input_string.size();
+
+    // end anchored patterns only get checked here, at the end of the input
+    return (current & END_MATCH_TAG) != 0;
+}
+
+void LazyDFA::start_line() {
+    line_on_nfa = fell_back;
+    if (line_on_nfa) nfa.start_line(fallback_scratch);
+    else line_state = start_state;
+}
+
+bool LazyDFA::resume(std::string_view piece) {
+    if (line_on_nfa) return nfa.resume(piece, fallback_scratch);
+    // a match or dead state has decided the line already
+    if (line_state >= DEAD_TAG) return true;
+    bytes_since_flush += piece.size();
+
+    // the same loop as run, except the state is kept for the next piece
+    uint32_t current = line_state;
+    const uint8_t* byte_class = classes.map().data();
+    const uint32_t* rows = table.data();
+    for (size_t i = 0; i < piece.size(); i++) {
+        const unsigned char ch = piece[i];
+        uint32_t next = rows[(current & ID_MASK) + byte_class[ch]];
+        if (next >= DEAD_TAG) {
+            if (next == UNKNOWN) {
+                next = compute_next(current, ch);
+                if (fell_back) {
+                    // the earlier pieces are gone, so hand the nfa the states this one has got to instead of redoing it
+                    steps += i + 1;
+                    line_on_nfa = true;
+                    nfa.start_line(dfa_states[(next & ID_MASK) / stride], fallback_scratch);
+                    return nfa.resume(piece.substr(i + 1), fallback_scratch);
+                }
+                rows = table.data();
+            }
+            if (next >= DEAD_TAG) {
+                steps += i + 1;
+                line_state = next;
+                return true;
+            }
+        }
+        current = next;
+    }
+    steps += piece.size();
+    line_state = current;
+    return false;
+}
+
+bool LazyDFA::end_line() const {
+    if (line_on_nfa) return nfa.end_line(fallback_scratch);
+    // every state with a Match in it has END_MATCH_TAG, the ones that matched early included
+    return (line_state & END_MATCH_TAG) != 0;
+}
+
+size_t LazyDFA::longest_match(std::string_view input, bool at_line_start) {
+    // only called for lines we know match, so this keeps using the cache even if run has given up on it
+    bytes_since_flush += input.size();
+
+    uint32_t current = at_line_start ? start_state : restart_start;
+    size_t longest = (current & MATCH_TAG) ? 0 : std::string_view::npos;
+    size_t i = 0;
+    // nothing is restarted, so once every match has died there's nothing more to find
+    for (; i < input.size() && !(current & DEAD_TAG); i++) {
+        current = step(current, input[i]);
+        if (current & MATCH_TAG) longest = i + 1;
+    }
+    steps += i;
+    if (i == input.size() && (current & END_MATCH_TAG)) longest = input.size();
+    return longest;
+}
+
+void LazyDFA::match_starts(std::string_view line, vector<size_t>& starts) {
+    bytes_since_flush += line.size();
+
+    // the reversed patterns restart at every position, so being in a match state at i means some match starts at i
+    // and a Match that needs the end of the (reversed) line is one anchored to the start of the real one
+    uint32_t current = start_state;
+    if ((current & MATCH_TAG) || (line.empty() && (current & END_MATCH_TAG))) starts.push_back(line.size());
+    size_t i = line.size();
+    while (i > 0 && !(current & DEAD_TAG)) {
+        i--;
+        current = step(current, line[i]);
+        if ((current & MATCH_TAG) || (i == 0 && (current & END_MATCH_TAG))) starts.push_back(i);
+    }
+    steps += line.size() - i;
+}
+
+uint32_t LazyDFA::compute_next(uint32_t current, unsigned char ch) {
+    // this is one step of NFA::run, but done once per (state, byte class) instead of once per byte
+    // every byte in ch's class would end up in the same set, so the answer goes in the class's column
+    misses++;
+    threads.clear();
+    for (StateId id : dfa_states[(current & ID_MASK) / stride]) {
+        const Inst& state = nfa.inst(id);
+        if (nfa.matches(state, ch)) {
+            nfa.add_closure(threads, state.out);
+        }
+    }
+    // substring matching: the unanchored patterns can start again at every position
+    if (!anchored && nfa.restart_state() != NO_STATE) {
+        nfa.add_closure(threads, nfa.restart_state());
+    }
+    // the set is built in a reused buffer, and only copied if it turns out to be a new state
+    collect_threads(set);
+
+    auto existing = state_ids.find(set);
+    if (existing != state_ids.end()) {
+        table[(current & ID_MASK) + classes.get(ch)] = existing->second;
+        return existing->second;
+    }
+
+    if (memory_used + state_cost(set) > config.memory_budget) {
+        flush();
+        // current is gone now, so there's no row to record the transition in
+        return add_state(set);
+    }
+
+    uint32_t next = add_state(set);
+    table[(current & ID_MASK) + classes.get(ch)] = next;
+    return next;
+}
+
+uint32_t LazyDFA::add_state(const vector<StateId>& set) {
+    memory_used += state_cost(set);
+
+    // a match state matches right away unless every Match in it needs the end of the line
+    bool match = false, match_now = false;
+    for (StateId state : set) {
+        const Inst& inst = nfa.inst(state);
+        if (inst.op != Inst::OP::Match) continue;
+        match = true;
+        if (!inst.end_anchored()) match_now = true;
+    }
+    // ids are where the state's row starts, so stepping doesn't need a multiply
+    uint32_t id = table.size();
+    if (match_now) id |= MATCH_TAG;
+    if (set.empty()) id |= DEAD_TAG;
+    if (match) id |= END_MATCH_TAG;
+
+    table.resize(table.size() + stride, UNKNOWN);
+    state_ids.emplace(set, id);
+    dfa_states.push_back(set);
+    return id;
+}
+
+void LazyDFA::flush() {
+    // if we're flushing again after barely using the cache, the pattern is blowing up the dfa
+    if (bytes_since_flush < config.min_bytes_per_state * dfa_states.size()) {
+        thrashing_flushes++;
+        if (thrashing_flushes >= config.max_thrashing_flushes) {
+            fell_back = true;
+        }
+    }
+    flushes++;
+    bytes_since_flush = 0;
+    peak_states = std::max(peak_states, dfa_states.size());
+
+    dfa_states.clear();
+    state_ids.clear();
+    table.clear();
+    memory_used = 0;
+
+    threads.clear();
+    // an nfa with no patterns in it (one loaded from a saved dfa) never matches anything
+    if (nfa.start_state() != NO_STATE) nfa.add_closure(threads, nfa.start_state());
+    // not the set member, compute_next can flush while it's holding the next state in that
+    vector<StateId> start_set;
+    collect_threads(start_set);
+    start_state = add_state(start_set);
+
+    if (anchored) {
+        threads.clear();
+        if (nfa.restart_state() != NO_STATE) nfa.add_closure(threads, nfa.restart_state());
+        collect_threads(start_set);
+        restart_start = add_state(start_set);
+    }
+}
+
+void LazyDFA::collect_threads(vector<StateId>& set) const {
+    // the closures never include epsilon states, so this is exactly the set that decides what the dfa state does next
+    set.assign(threads.begin(), threads.end());
+    std::sort(set.begin(), set.end());
+}
+
+size_t LazyDFA::state_cost(const vector<StateId>& set) const {
+    // one table row, the set stored twice (in dfa_states and as a map key), plus some container overhead
+    return stride * sizeof(uint32_t) + 2 * set.size() * sizeof(StateId) + 64;
+}
+
+size_t LazyDFA::StateSetHash::operator()(const vector<StateId>& set) const {
+    size_t hash = set.size();
+    for (StateId id : set) {
+        hash ^= id + 0x9e3779b97f4a7c15ULL + (hash << 6) + (hash >> 2);
+    }
+    return hash;
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "match_scratch.h"
+#include "nfa.h"
+#include "sparse_set.h"
+
+using std::vector;
+
+// knobs for the lazy dfa cache
+struct LazyDFAConfig {
+    // roughly how many bytes the cached states and transition table are allowed to use
+    size_t memory_budget = 2 * 1024 * 1024;
+    // how many thrashing flushes we put up with before giving up and using the nfa
+    int max_thrashing_flushes = 3;
+    // a flush counts as thrashing if we scanned fewer than this many bytes per cached state since the last flush
+    size_t min_bytes_per_state = 10;
+};
+
+// A DFA that is built on demand while matching (subset construction, one transition at a time).
+// Each DFA state is the epsilon closed set of NFA states we could be in, and every transition we work
+// out gets cached in a dense table, so once the cache is warm matching is one table lookup per byte.
+// The table has a column per byte equivalence class rather than per byte, which keeps the rows short.
+// If the cache fills up it gets flushed, and if that keeps happening we fall back to NFA::run.
+//
+// The same cache also answers where matches are, for Matcher's spans. An anchored dfa doesn't restart the patterns at
+// every position, so it can follow the matches from one start and find where the longest one ends, and a dfa over
+// the reversed patterns (RegexCompiler::compile_reverse) run backwards from the end of a line finds where they start.
+class LazyDFA {
+public:
+    // anchored: matches have to start at the start of the input (for longest_match)
+    explicit LazyDFA(const NFA& nfa, LazyDFAConfig config = {}, bool anchored = false);
+    ~LazyDFA() = default;
+
+    // same answer as NFA::run, just (usually) a lot faster
+    bool run(std::string_view);
+
+    // run, for a line that comes in pieces (StreamMatcher): start_line, then resume with each piece, then end_line
+    // resume returns true once the rest of the line can't change the answer, and then it doesn't need feeding any more
+    // if the cache gives up halfway through a line, the nfa carries on from the states the dfa had got to
+    void start_line();
+    bool resume(std::string_view piece);
+    bool end_line() const;
+
+    // for an anchored dfa: the length of the longest match at the start of input, npos if there isn't one
+    // input runs to the end of the line, at_line_start says whether it starts at the start of it too (for ^)
+    size_t longest_match(std::string_view input, bool at_line_start);
+    // for an unanchored dfa over the reversed patterns: adds every position in line that a match starts at, right to left
+    void match_starts(std::string_view line, vector<size_t>& starts);
+
+    // true once the cache has thrashed too often and we've switched to the nfa for good
+    bool using_nfa() const { return fell_back; }
+    size_t cached_states() const { return dfa_states.size(); }
+    int flush_count() const { return flushes; }
+    // for --stats: bytes stepped over a transition that was already in the table, and transitions that weren't
+    uint64_t cache_hits() const { return steps - misses; }
+    uint64_t cache_misses() const { return misses; }
+    // the most states the cache has held at once
+    size_t peak_cached_states() const { return std::max(peak_states, dfa_states.size()); }
+    // the most nfa states active at once, once we've fallen back to the nfa
+    uint32_t peak_nfa_threads() const { return fallback_scratch.peak_threads; }
+
+private:
+    // table entries are dfa state ids, with the top bits used as tags so the hot loop only needs one compare
+    // an id is the offset of the state's row in the table, its index in dfa_states is id / stride
+    static constexpr uint32_t UNKNOWN = 0xFFFFFFFF;
+    static constexpr uint32_t MATCH_TAG = 1u << 30;
+    static constexpr uint32_t DEAD_TAG = 1u << 29;
+    // the state has a Match in it (possibly one that only counts at the end of the line), which the hot loop doesn't care about
+    static constexpr uint32_t END_MATCH_TAG = 1u << 28;
+    static constexpr uint32_t ID_MASK = END_MATCH_TAG - 1;
+
+    struct StateSetHash {
+        size_t operator()(const vector<StateId>& set) const;
+    };
+
+    const NFA& nfa;
+    LazyDFAConfig config;
+    bool anchored;
+    const ByteClasses& classes;
+    // row length of the table
+    uint32_t stride;
+
+    // dfa state id -> sorted set of nfa states (only the ones that consume a byte or match)
+    vector<vector<StateId>> dfa_states;
+    // sorted set of nfa states -> tagged dfa state id
+    std::unordered_map<vector<StateId>, uint32_t, StateSetHash> state_ids;
+    // dfa_states.size() rows of stride tagged ids
+    vector<uint32_t> table;
+
+    uint32_t start_state = UNKNOWN;
+    // where the line resume is working through has got to, and whether that's in fallback_scratch instead
+    uint32_t line_state = UNKNOWN;
+    bool line_on_nfa = false;
+    // where an anchored dfa starts away from the start of the line, the closure of the nfa's restart
+    uint32_t restart_start = UNKNOWN;
+    size_t memory_used = 0;
+    size_t bytes_since_flush = 0;
+    int flushes = 0;
+    int thrashing_flushes = 0;
+    bool fell_back = false;
+    // bytes stepped and transitions worked out, for cache_hits and cache_misses
+    uint64_t steps = 0;
+    uint64_t misses = 0;
+    size_t peak_states = 0;
+
+    // scratch space for working out new states
+    SparseSet threads;
+    vector<StateId> set;
+    // for NFA::run, once we've fallen back to it
+    MatchScratch fallback_scratch;
+
+    // helpers
+    uint32_t add_state(const vector<StateId>& set);
+    uint32_t compute_next(uint32_t current, unsigned char ch);
+    uint32_t step(uint32_t current, unsigned char ch) {
+        uint32_t next = table[(current & ID_MASK) + classes.get(ch)];
+        return next == UNKNOWN ? compute_next(current, ch) : next;
+    }
+    void flush();
+    void collect_threads(vector<StateId>& set) const;
+    size_t state_cost(const vector<StateId>& set) const;
+};
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "sparse_set.h"
+
+using std::vector;
+
+// The working memory of a simulation: the two thread lists NFA::run steps between, and a flag per pattern
+// for match_patterns. Keep one per thread and hand it to every call, and once it has grown to fit the biggest
+// automaton it's used with, matching doesn't allocate anything. (The overloads that don't take one make a
+// fresh one every call, which is fine for a one off match but not in a loop.)
+struct MatchScratch {
+    SparseSet current;
+    SparseSet next;
+    vector<char> matched;
+    // the most states a simulation has had active at once (for --stats)
+    uint32_t peak_threads = 0;
+
+    // make room for an automaton with this many states and patterns, does nothing once there's enough
+    void reserve(uint32_t states, uint32_t patterns) {
+        if (current.capacity() < states) {
+            current.resize(states);
+            next.resize(states);
+        }
+        if (matched.size() < patterns) matched.resize(patterns, 0);
+    }
+};
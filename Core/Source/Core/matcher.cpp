@@ -0,0 +1,58 @@
+#include "matcher.h"
+
+Matcher::Matcher(const Regex& regex, LazyDFAConfig config):
+    nfa(regex.get_nfa()), prefilter(regex.get_prefilter()), literals(regex.get_literals()), bit_parallel(regex.get_bit_parallel()), dense_dfa(regex.get_dense_dfa()), dfa(nfa, config) {
+    if (const NFA* reverse_nfa = regex.get_reverse_nfa()) {
+        reverse_dfa.emplace(*reverse_nfa, config);
+        anchored_dfa.emplace(nfa, config, true);
+    }
+}
+
+bool Matcher::is_match(std::string_view line) {
+    if (counting) return counted_is_match(line);
+    if (literals) return literals->is_match(line);
+    if (!prefilter.empty()) {
+        if (prefilter.find(line) == std::string_view::npos) return false;
+        // if the literal is the whole pattern, we're done
+        return confirm(line);
+    }
+    return run_automaton(line);
+}
+
+bool Matcher::counted_is_match(std::string_view line) {
+    counts.bytes_scanned += line.size();
+    if (find_candidate(line, 0) == std::string_view::npos) {
+        counts.bytes_skipped += line.size();
+        counts.lines_skipped++;
+        return false;
+    }
+    counts.lines_tested++;
+    bool matched = confirm(line);
+    counts.lines_matched += matched;
+    return matched;
+}
+
+MatchStats Matcher::stats() const {
+    MatchStats total = counts;
+    total.engine = engine_name();
+    total.nfa_peak_threads = scratch.peak_threads;
+    for (const LazyDFA* lazy : {&dfa, reverse_dfa ? &*reverse_dfa : nullptr, anchored_dfa ? &*anchored_dfa : nullptr}) {
+        if (!lazy) continue;
+        total.dfa_cache_hits += lazy->cache_hits();
+        total.dfa_cache_misses += lazy->cache_misses();
+        total.dfa_flushes += lazy->flush_count();
+        total.dfa_peak_states = std::max<uint64_t>(total.dfa_peak_states, lazy->peak_cached_states());
+        total.dfa_fallbacks += lazy->using_nfa();
+        total.nfa_peak_threads = std::max<uint64_t>(total.nfa_peak_threads, lazy->peak_nfa_threads());
+    }
+    return total;
+}
+
+const char* Matcher::engine_name() const {
+    if (literals) return "aho-corasick";
+    if (prefilter.is_exact()) return "literal";
+    if (dense_dfa) return "dense dfa";
+    if (bit_parallel) return "bit-parallel";
+    // whether it's had to fall back to the nfa is in the stats
+    return "lazy dfa";
+}
@@ -0,0 +1,170 @@
+#pragma once
+
+#include <algorithm>
+#include <optional>
+#include <string_view>
+
+#include "aho_corasick.h"
+#include "bit_parallel.h"
+#include "dense_dfa.h"
+#include "lazy_dfa.h"
+#include "nfa.h"
+#include "pike_vm.h"
+#include "prefilter.h"
+#include "regex.h"
+#include "stats.h"
+
+// Line matcher that picks the fastest engine the compiled patterns allow.
+// A set of plain literals goes straight to aho-corasick. Otherwise the prefilter goes in front of the automaton:
+// lines without the required literal are thrown out at memchr speed, and only the ones left go through the
+// saved dfa (if we loaded one), the bit-parallel simulation (for small patterns) or the lazy dfa.
+// Every engine's working memory lives in the Matcher, so keep one per thread and reuse it: once the dfa
+// cache is warm, matching lines doesn't allocate anything.
+class Matcher {
+public:
+    explicit Matcher(const Regex& regex, LazyDFAConfig config = {});
+    ~Matcher() = default;
+
+    // does the pattern match somewhere in line
+    bool is_match(std::string_view line);
+
+    // calls on_match(line) for every line in buffer the pattern matches, in order
+    // lines are split on '\n' (which isn't part of the line) and the last one doesn't need a '\n' after it
+    // with a prefilter (or literal set) we search the whole buffer and only find the line boundaries around each hit
+    template <typename OnMatch>
+    void for_each_match(std::string_view buffer, OnMatch&& on_match);
+
+    // calls on_span(start, end) for every match in line, left to right, as offsets into line
+    // matches are leftmost-longest and don't overlap, and empty ones are skipped (like grep -o does)
+    // line has to be one is_match/for_each_match said matches, and the Regex has to have been built with spans
+    template <typename OnSpan>
+    void for_each_span(std::string_view line, OnSpan&& on_span);
+
+    // for_each_span, but on_captures gets the capture slots of each match (see PikeVM::captures), group 0 being the span
+    // the Pike VM only runs over the spans, and only gets set up the first time this is called
+    template <typename OnCaptures>
+    void for_each_captures(std::string_view line, OnCaptures&& on_captures);
+
+    // fills ids with every pattern (of a multi pattern regex) that matches line
+    void match_patterns(std::string_view line, vector<uint32_t>& ids) {
+        if (literals) literals->match_patterns(line, ids, scratch);
+        else nfa.match_patterns(line, ids, scratch);
+    }
+
+    const Prefilter& get_prefilter() const { return prefilter; }
+
+    // count lines and bytes for stats (off by default, when it costs a branch per line that gets looked at)
+    void collect_stats(bool on) { counting = on; }
+    // what this matcher has done so far, with the counters of the engines it's been using
+    MatchStats stats() const;
+    // which engine run_automaton uses, for --stats
+    const char* engine_name() const;
+
+private:
+    const NFA& nfa;
+    const Prefilter& prefilter;
+    const AhoCorasick* literals;
+    const BitParallel* bit_parallel;
+    const DenseDFA* dense_dfa;
+    LazyDFA dfa;
+    MatchScratch scratch;
+    // for spans: the reversed patterns find where matches start, then an anchored dfa finds where the longest one ends
+    std::optional<LazyDFA> reverse_dfa;
+    std::optional<LazyDFA> anchored_dfa;
+    vector<size_t> starts;
+    std::optional<PikeVM> pike_vm;
+    vector<size_t> slots;
+    bool counting = false;
+    MatchStats counts;
+
+    bool counted_is_match(std::string_view line);
+
+    bool run_automaton(std::string_view line) {
+        if (dense_dfa) return dense_dfa->run(line);
+        return bit_parallel ? bit_parallel->run(line) : dfa.run(line);
+    }
+
+    // where the next line that might match is, npos if there isn't one, or pos itself when we can't tell
+    size_t find_candidate(std::string_view buffer, size_t pos) const {
+        if (literals) return literals->find(buffer, pos);
+        if (!prefilter.empty()) return prefilter.find(buffer, pos);
+        return pos;
+    }
+
+    // is_match for a line that find_candidate pointed us at
+    bool confirm(std::string_view line) {
+        return literals || prefilter.is_exact() || run_automaton(line);
+    }
+
+    // lines the prefilter jumped over, which only gets worked out for stats
+    void count_skipped(std::string_view skipped) {
+        counts.bytes_skipped += skipped.size();
+        counts.lines_skipped += std::count(skipped.begin(), skipped.end(), '\n');
+        if (!skipped.empty() && skipped.back() != '\n') counts.lines_skipped++;
+    }
+};
+
+template <typename OnMatch>
+void Matcher::for_each_match(std::string_view buffer, OnMatch&& on_match) {
+    if (counting) counts.bytes_scanned += buffer.size();
+    size_t pos = 0;
+    while (pos < buffer.size()) {
+        // no more hits means no more matching lines in this buffer
+        size_t hit = find_candidate(buffer, pos);
+        if (hit == std::string_view::npos) {
+            if (counting) count_skipped(buffer.substr(pos));
+            return;
+        }
+        if (hit > pos) {
+            // hit - 1 is always inside the hit's line (aho-corasick hits point just past the literal)
+            // and pos is always at the start of a line, so this stops at pos - 1 at the latest
+            size_t line_start = buffer.rfind('\n', hit - 1);
+            if (line_start != std::string_view::npos && line_start >= pos) {
+                if (counting) count_skipped(buffer.substr(pos, line_start + 1 - pos));
+                pos = line_start + 1;
+            }
+        }
+
+        size_t line_end = buffer.find('\n', pos);
+        if (line_end == std::string_view::npos) line_end = buffer.size();
+        std::string_view line = buffer.substr(pos, line_end - pos);
+
+        bool matched = confirm(line);
+        if (counting) {
+            counts.lines_tested++;
+            counts.lines_matched += matched;
+        }
+        if (matched) on_match(line);
+        pos = line_end + 1;
+    }
+}
+
+template <typename OnSpan>
+void Matcher::for_each_span(std::string_view line, OnSpan&& on_span) {
+    // the forward scan that picked this line out already knows it matches, so what's left is finding where
+    // one backwards pass finds every position a match starts at, and each match is followed forwards from the leftmost one left
+    starts.clear();
+    reverse_dfa->match_starts(line, starts);
+
+    size_t pos = 0;
+    // starts are right to left, so the next one is at the back
+    while (!starts.empty()) {
+        size_t start = starts.back();
+        starts.pop_back();
+        if (start < pos) continue;
+
+        size_t length = anchored_dfa->longest_match(line.substr(start), start == 0);
+        if (length == std::string_view::npos || length == 0) continue;
+        on_span(start, start + length);
+        pos = start + length;
+    }
+}
+
+template <typename OnCaptures>
+void Matcher::for_each_captures(std::string_view line, OnCaptures&& on_captures) {
+    if (!pike_vm) pike_vm.emplace(nfa);
+    // the dfas already found each match, the Pike VM only has to work out how the groups split it up
+    for_each_span(line, [&](size_t start, size_t end) {
+        if (pike_vm->captures(line, start, end, slots)) on_captures(static_cast<const vector<size_t>&>(slots));
+    });
+}
@@ -1,84 +1,217 @@
 #include "nfa.h"
 
-#include <iostream>
-#include <ostream>
+#include <algorithm>
+#include <unordered_set>
 
 #include "nfa_fragment.h"
 
-NFA::NFA(State* start, State* accept, vector<unique_ptr<State>> states_vec): start(start), accept(accept), states(std::move(states_vec)) {}
+StateId NFA::add_inst(Inst inst) {
+    program.push_back(inst);
+    return program.size() - 1;
+}
+
+uint32_t NFA::add_class(const ByteSet& set) {
+    auto [it, added] = class_ids.try_emplace(set, classes.size());
+    if (added) classes.push_back(set);
+    return it->second;
+}
+
+void NFA::add_pattern(NFAFragment final, bool start_anchor, bool end_anchor) {
+    // the fragment's dangling accept becomes this pattern's Match
+    program[final.accept] = Inst::match(patterns++, end_anchor);
+    pattern_starts.push_back(final.start);
+    if (!start_anchor) unanchored_starts.push_back(final.start);
+}
+
+void NFA::finish() {
+    start = split_over(pattern_starts);
+    restart = split_over(unanchored_starts);
+    for (const Inst& state : program) {
+        if (state.op == Inst::OP::Save) slots = std::max(slots, state.slot() + 1);
+    }
+    compute_closures();
+    compute_equivalence_classes();
+}
+
+StateId NFA::split_over(const vector<StateId>& states) {
+    // a chain of splits that can go to any of states
+    if (states.empty()) return NO_STATE;
+    StateId first = states.back();
+    for (int i = static_cast<int>(states.size()) - 2; i >= 0; i--) {
+        first = add_inst(Inst::split(states[i], first));
+    }
+    return first;
+}
 
-State* NFA::new_state(bool is_accept) {
-    states.emplace_back(std::make_unique<State>(is_accept));
-    return states.back().get();
+bool NFA::run(std::string_view input_string, MatchScratch& scratch) const {
+    start_line(scratch);
+    return resume(input_string, scratch) || end_line(scratch);
 }
-void NFA::add_final_fragment(NFAFragment final) {
-    start = final.start;
-    accept = final.accept;
+
+void NFA::start_line(MatchScratch& scratch) const {
+    scratch.reserve(program.size(), patterns);
+    scratch.current.clear();
+    add_closure(scratch.current, start);
+}
+
+void NFA::start_line(std::span<const StateId> states, MatchScratch& scratch) const {
+    scratch.reserve(program.size(), patterns);
+    scratch.current.clear();
+    for (StateId id : states) scratch.current.insert(id);
 }
 
-bool NFA::run(std::string const& input_string) {
-    // initialise current_states by getting all the states reachable by epsilon alone from the nfa's start state
-    // the nfa is basically a directed graph, so this is traversing a graph and adding the accept states to current_states
-    // this can be a helper function, find epsilon closures from a given start state (or set of start states?), returns all states reachable by epsilons alone
-    unordered_set<State*> current_states = {start};
-    epsilon_closures(current_states);
-
-    for (const char ch : input_string) {
-	if (!end_anchor) {
-		if (current_states.find(accept) != current_states.end()) return true;
-	}
-        unordered_set<State*> next_candidates;
-        for (State* state : current_states) {
-            // I want to add to next candidates every time, so initialise it outside of this for loop, then extend it inside this for loop, then get next_states at the end of this for loop (ie next states at the end of the loop for this character)
-            unordered_set<State*> targets = state->get_targets(ch);
-            next_candidates.insert(targets.begin(), targets.end());
+bool NFA::resume(std::string_view piece, MatchScratch& scratch) const {
+    // current holds the states we could be in, next the ones we could be in after this char
+    // the closures are precomputed, so these only ever hold states that consume a byte (or Match states)
+    SparseSet* current = &scratch.current;
+    SparseSet* next = &scratch.next;
+    bool matched = false;
+
+    for (const char c : piece) {
+        const unsigned char ch = c;
+        next->clear();
+        for (StateId id : *current) {
+            const Inst& state = program[id];
+            // a match that doesn't need the end of the line means we're done
+            if (state.op == Inst::OP::Match) {
+                if (!state.end_anchored()) {
+                    matched = true;
+                    break;
+                }
+                continue;
+            }
+            if (matches(state, ch)) {
+                add_closure(*next, state.out);
+            }
+        }
+        if (matched) break;
+        // for substring matching, add the start state back in here
+        // (only for the patterns that aren't anchored to the start)
+        if (restart != NO_STATE) {
+            add_closure(*next, restart);
         }
-	// for substring matching, add the start state back in here
-	// check for anchors too
-	if (!start_anchor) {
-			next_candidates.insert(start);
-	}
-	
-        epsilon_closures(next_candidates);
-        current_states = std::move(next_candidates);
+        std::swap(current, next);
+        if (current->size() > scratch.peak_threads) scratch.peak_threads = current->size();
     }
 
-    // if nfa.accept is in current_states, return true, else false
-    if (current_states.find(accept) != current_states.end()) {return true;}
+    // the loop swaps the pointers, the next piece wants the states back in scratch.current
+    if (current != &scratch.current) std::swap(scratch.current, scratch.next);
+    return matched;
+}
+
+bool NFA::end_line(const MatchScratch& scratch) const {
+    // at the end of the line any match counts
+    for (StateId id : scratch.current) {
+        if (program[id].op == Inst::OP::Match) return true;
+    }
     return false;
 }
 
-void NFA::dfsr(unordered_set<State*>& visited, State* current_state) {
-    visited.insert(current_state);
-    // get the 'neighbours' ie the states reachable by epsilon
-    vector<State*> neighbours;
-    for (Transition transition: current_state->transitions) {
-        if (!transition.symbol) {
-            // this is getting a list of neighbours
-            neighbours.emplace_back(transition.target);
+void NFA::match_patterns(std::string_view input, vector<uint32_t>& ids, MatchScratch& scratch) const {
+    scratch.reserve(program.size(), patterns);
+    vector<char>& matched = scratch.matched;
+    std::fill(matched.begin(), matched.begin() + patterns, 0);
+    SparseSet* current = &scratch.current;
+    SparseSet* next = &scratch.next;
+    current->clear();
+
+    add_closure(*current, start);
+
+    for (const char c : input) {
+        const unsigned char ch = c;
+        next->clear();
+        for (StateId id : *current) {
+            const Inst& state = program[id];
+            if (state.op == Inst::OP::Match) {
+                if (!state.end_anchored()) matched[state.pattern()] = true;
+                continue;
+            }
+            if (matches(state, ch)) {
+                add_closure(*next, state.out);
+            }
         }
+        if (restart != NO_STATE) {
+            add_closure(*next, restart);
+        }
+        std::swap(current, next);
+        if (current->size() > scratch.peak_threads) scratch.peak_threads = current->size();
+    }
+    for (StateId id : *current) {
+        if (program[id].op == Inst::OP::Match) matched[program[id].pattern()] = true;
     }
 
-    for (State* state : neighbours) {
-        if (visited.find(state) == visited.end()) {
-            dfsr(visited, state);
-        }
+    ids.clear();
+    for (uint32_t i = 0; i < patterns; i++) {
+        if (matched[i]) ids.push_back(i);
+    }
+}
+
+void NFA::compute_equivalence_classes() {
+    // two bytes are in the same class if every transition either takes both or neither
+    // lots of states take the same bytes (every 'a', every \d), and refining by the same set twice does nothing,
+    // so each distinct set only gets refined by once. Char and ByteRange are keyed by their range, Class by its index
+    equivalence = ByteClasses();
+    std::unordered_set<uint64_t> seen;
+    for (const Inst& state : program) {
+        if (!state.consumes()) continue;
+        uint64_t key = state.op == Inst::OP::Class ? (uint64_t{1} << 32) | state.out1 : (uint64_t{state.lo} << 8) | state.hi;
+        if (!seen.insert(key).second) continue;
+        equivalence.refine([&](unsigned char ch) { return matches(state, ch); });
+        if (equivalence.size() == 256) break;
     }
 }
 
-unordered_set<State*> NFA::dfs(State* start_vertex) {
-	// this is a depth first search
-    unordered_set<State*> visited;
-    dfsr(visited, start_vertex);
-    return visited;
+void NFA::compute_closures() {
+    // we only ever need closures of the start states and of the targets of consuming states
+    vector<StateId> targets = {start};
+    if (restart != NO_STATE) targets.push_back(restart);
+    for (const Inst& state : program) {
+        if (state.consumes()) targets.push_back(state.out);
+    }
+
+    closures.assign(program.size(), Closure{});
+    closure_states.clear();
+    vector<bool> done(program.size(), false);
+
+    SparseSet threads(program.size());
+    vector<StateId> stack;
+    for (StateId target : targets) {
+        // Jmp chains (like the ends of an alternation) all lead to the same closure, so work it out once at the end of the chain
+        // a Jmp can't point back at itself through other Jmps, Thompson's construction never makes a cycle of them
+        StateId end = target;
+        while (program[end].op == Inst::OP::Jmp) end = program[end].out;
+
+        if (!done[end]) {
+            threads.clear();
+            add_thread(threads, end, stack);
+            closures[end].begin = closure_states.size();
+            for (StateId id : threads) {
+                if (!program[id].is_epsilon()) closure_states.push_back(id);
+            }
+            closures[end].end = closure_states.size();
+            done[end] = true;
+        }
+        closures[target] = closures[end];
+    }
 }
 
-void NFA::epsilon_closures(unordered_set<State*>& start_states) {
-    // adds epsilon closures to start_states
-	unordered_set<State*> additional_states;
-    for (State* state : start_states) {
-        unordered_set<State*> closure = dfs(state);
-        additional_states.insert(closure.begin(), closure.end());
+void NFA::add_thread(SparseSet& threads, StateId id, vector<StateId>& stack) const {
+    // depth first search over the epsilon transitions, with an explicit stack
+    stack.push_back(id);
+    while (!stack.empty()) {
+        StateId current = stack.back();
+        stack.pop_back();
+        if (threads.contains(current)) continue;
+        threads.insert(current);
+
+        const Inst& state = program[current];
+        if (state.op == Inst::OP::Jmp || state.op == Inst::OP::Save) {
+            stack.push_back(state.out);
+        }
+        else if (state.op == Inst::OP::Split) {
+            // push out1 first so out gets explored first
+            stack.push_back(state.out1);
+            stack.push_back(state.out);
+        }
     }
-	start_states.insert(additional_states.begin(), additional_states.end());
 }
@@ -1,20 +1,23 @@
 #pragma once
 
-#include <unordered_set>
+#include <span>
+#include <string_view>
+#include <unordered_map>
 #include <vector>
-#include <memory>
 
+#include "byte_classes.h"
+#include "byte_set.h"
+#include "inst.h"
+#include "match_scratch.h"
 #include "nfa_fragment.h"
-#include "state.h"
+#include "sparse_set.h"
 
-using std::vector, std::unique_ptr, std::unordered_set;
+using std::vector;
 
 class NFA {
 public:
     // default constructor
     NFA() = default;
-    // construct from values
-    NFA(State* start, State* accept, vector<unique_ptr<State>> states);
     // default deconstructor
     ~NFA() = default;
 
@@ -23,28 +26,113 @@ public:
     NFA(NFA&&) = default;
     NFA& operator=(NFA&&) = default;
 
-	// add booleans for start and end anchors
-	bool start_anchor = false;
-	bool end_anchor = false;
+    // add an instruction to the program and return its id
+    StateId add_inst(Inst inst);
+    Inst& inst(StateId id) { return program[id]; }
+    const Inst& inst(StateId id) const { return program[id]; }
 
-    // add a state to states and return the raw pointer
-    State* new_state(bool);
+    // add a character class to the classes table (reusing an identical one if it's already there)
+    uint32_t add_class(const ByteSet& set);
 
-    // add final fragment to nfa that sets start and accept states
-    void add_final_fragment(NFAFragment final);
+    // add a finished pattern: its final fragment's accept becomes a Match tagged with the pattern's id
+    // the anchors are per pattern, so several patterns can share one NFA
+    void add_pattern(NFAFragment final, bool start_anchor, bool end_anchor);
+
+    // call once all the patterns are in: sets up the start states and precomputes the closures
+    void finish();
+
+    // run the NFA with an input string, true if any of its patterns match
+    bool run(std::string_view input, MatchScratch& scratch) const;
+    bool run(std::string_view input) const {
+        MatchScratch scratch;
+        return run(input, scratch);
+    }
+
+    // run, for a line that comes in pieces (StreamMatcher): start_line, then resume with each piece, then end_line
+    // the states in between are kept in scratch.current. resume returns true once a match is certain, and then
+    // the rest of the line doesn't need to be fed in
+    void start_line(MatchScratch& scratch) const;
+    // start from states instead, which have to be closed already (LazyDFA hands its line over like this when it gives up)
+    void start_line(std::span<const StateId> states, MatchScratch& scratch) const;
+    bool resume(std::string_view piece, MatchScratch& scratch) const;
+    bool end_line(const MatchScratch& scratch) const;
+
+    // fills ids (in ascending order) with every pattern that matches input
+    // unlike run this can't stop at the first match, so it's for lines we already know match
+    void match_patterns(std::string_view input, vector<uint32_t>& ids, MatchScratch& scratch) const;
+    void match_patterns(std::string_view input, vector<uint32_t>& ids) const {
+        MatchScratch scratch;
+        match_patterns(input, ids, scratch);
+    }
+
+    // read access for the other engines that are built from the program
+    // start is where every pattern starts, restart is where the unanchored ones start again at every later position
+    StateId start_state() const { return start; }
+    StateId restart_state() const { return restart; }
+    uint32_t pattern_count() const { return patterns; }
+    // capture slots the Saves use, two per group (0 and 1 are the whole match, which has no Saves)
+    uint32_t slot_count() const { return slots; }
+    uint32_t size() const { return program.size(); }
+    const ByteSet& byte_class(uint32_t index) const { return classes[index]; }
+    // which bytes every transition treats the same, for engines that want a table column per class instead of per byte
+    const ByteClasses& equivalence_classes() const { return equivalence; }
+
+    // does this state consume ch
+    bool matches(const Inst& state, unsigned char ch) const {
+        switch (state.op) {
+            case Inst::OP::Char:
+            case Inst::OP::ByteRange:
+                // Char keeps hi == lo, so it's the same test as a range
+                return state.lo <= ch && ch <= state.hi;
+            case Inst::OP::Class:
+                return classes[state.out1].contains(ch);
+            default:
+                return false;
+        }
+    }
+
+    // every non-epsilon state reachable from id by epsilons alone (including id itself if it isn't one)
+    // these are worked out once when the NFA is finished, for the start state and everything a byte can lead to
+    std::span<const StateId> closure(StateId id) const {
+        const Closure& c = closures[id];
+        return {closure_states.data() + c.begin, c.end - c.begin};
+    }
+
+    // add the closure of id to threads
+    void add_closure(SparseSet& threads, StateId id) const {
+        for (StateId state : closure(id)) {
+            if (!threads.contains(state)) threads.insert(state);
+        }
+    }
 
-    // run the NFA with an input string
-    bool run(std::string const&);
 private:
-    // NFA internals (each transition is stored in a state)
-    State* start = nullptr;
-    // use a unique_ptr so that the addresses are stable as you add to the vector
-    vector<unique_ptr<State>> states;
-    State* accept = nullptr;
+    // NFA internals, one contiguous program indexed by StateId
+    vector<Inst> program;
+    // bitmaps for the Class instructions, and where each one is so identical classes get shared
+    vector<ByteSet> classes;
+    std::unordered_map<ByteSet, uint32_t, ByteSetHash> class_ids;
+    ByteClasses equivalence;
+    StateId start = NO_STATE;
+    // NO_STATE if every pattern is anchored to the start of the line
+    StateId restart = NO_STATE;
+    uint32_t patterns = 0;
+    uint32_t slots = 2;
+
+    // the start of each pattern, and the ones that aren't anchored to the start of the line
+    vector<StateId> pattern_starts;
+    vector<StateId> unanchored_starts;
 
+    // precomputed epsilon closures, closures[id] is a slice of closure_states
+    struct Closure {
+        uint32_t begin = 0;
+        uint32_t end = 0;
+    };
+    vector<Closure> closures;
+    vector<StateId> closure_states;
 
     // helpers
-    void epsilon_closures(unordered_set<State*>& start_states);
-    unordered_set<State*> dfs(State* start_vertex);
-    void dfsr(unordered_set<State*>& visited, State* current_state);
+    StateId split_over(const vector<StateId>& states);
+    void compute_closures();
+    void compute_equivalence_classes();
+    void add_thread(SparseSet& threads, StateId id, vector<StateId>& stack) const;
 };
@@ -3,14 +3,15 @@
 //
 
 #pragma once
-#include "state.h"
+#include "inst.h"
 
+// a partly built piece of the NFA. accept is a Jmp whose target hasn't been filled in yet
 struct NFAFragment {
-    State* start;
-    State* accept;
+    StateId start = NO_STATE;
+    StateId accept = NO_STATE;
 
 public:
-    NFAFragment(State* start, State* accept): start(start), accept(accept) {}
+    NFAFragment(StateId start, StateId accept): start(start), accept(accept) {}
     ~NFAFragment()=default;
     NFAFragment()=default;
 };
@@ -0,0 +1,84 @@
+#include "pike_vm.h"
+
+#include <algorithm>
+
+PikeVM::PikeVM(const NFA& nfa): nfa(nfa), slot_count(nfa.slot_count()), scratch(slot_count) {
+    for (Threads* threads : {&current, &next}) {
+        threads->states.resize(nfa.size());
+        threads->slots.resize(size_t{nfa.size()} * slot_count);
+    }
+}
+
+bool PikeVM::captures(std::string_view line, size_t start, size_t end, vector<size_t>& slots) {
+    // away from the start of the line only the unanchored patterns can start
+    StateId first = start == 0 ? nfa.start_state() : nfa.restart_state();
+    if (first == NO_STATE) return false;
+
+    current.states.clear();
+    std::fill(scratch.begin(), scratch.end(), std::string_view::npos);
+    add_thread(current, first, start);
+
+    for (size_t pos = start; pos < end && !current.states.empty(); pos++) {
+        const unsigned char ch = line[pos];
+        next.states.clear();
+        // in priority order, so a state the next step reaches twice keeps the slots of the better path
+        for (StateId id : current.states) {
+            const Inst& state = nfa.inst(id);
+            if (!nfa.matches(state, ch)) continue;
+            const size_t* from = current.slots.data() + size_t{id} * slot_count;
+            std::copy(from, from + slot_count, scratch.begin());
+            add_thread(next, state.out, pos + 1);
+        }
+        std::swap(current, next);
+    }
+
+    // the first Match in priority order is the one a backtracker would have stopped at
+    for (StateId id : current.states) {
+        const Inst& state = nfa.inst(id);
+        if (state.op != Inst::OP::Match) continue;
+        if (state.end_anchored() && end != line.size()) continue;
+        const size_t* from = current.slots.data() + size_t{id} * slot_count;
+        slots.assign(from, from + slot_count);
+        slots[0] = start;
+        slots[1] = end;
+        return true;
+    }
+    return false;
+}
+
+void PikeVM::add_thread(Threads& threads, StateId id, size_t pos) {
+    // NFA::add_thread, but depth first in priority order, with scratch holding the slots of the path we're on
+    stack.push_back({id, 0, 0});
+    while (!stack.empty()) {
+        Frame frame = stack.back();
+        stack.pop_back();
+        if (frame.id == NO_STATE) {
+            scratch[frame.slot] = frame.value;
+            continue;
+        }
+        if (threads.states.contains(frame.id)) continue;
+        threads.states.insert(frame.id);
+
+        const Inst& state = nfa.inst(frame.id);
+        switch (state.op) {
+            case Inst::OP::Jmp:
+                stack.push_back({state.out, 0, 0});
+                break;
+            case Inst::OP::Split:
+                // out is the branch to prefer, so it goes on top
+                stack.push_back({state.out1, 0, 0});
+                stack.push_back({state.out, 0, 0});
+                break;
+            case Inst::OP::Save:
+                // undo the save once everything after it has been added
+                stack.push_back({NO_STATE, state.slot(), scratch[state.slot()]});
+                scratch[state.slot()] = pos;
+                stack.push_back({state.out, 0, 0});
+                break;
+            default:
+                // a state that consumes a byte or matches keeps the slots it got here with
+                std::copy(scratch.begin(), scratch.end(), threads.slots.begin() + size_t{frame.id} * slot_count);
+                break;
+        }
+    }
+}
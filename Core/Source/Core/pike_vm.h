@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+#include "nfa.h"
+#include "sparse_set.h"
+
+using std::vector;
+
+// Pike VM: the NFA simulation again, but every thread carries capture slots along with it (where each group
+// started and ended on the way to that state). Threads are kept in priority order, so when two paths reach
+// the same state the one a backtracker would have tried first wins, and it's still one pass, O(nm) like NFA::run.
+// The slot arrays live in two pools sized up front (one block per NFA state, for this step and the next),
+// so a step copies slots around but never allocates. It's only used to pull the groups out of a match we
+// already found with the DFAs, so it doesn't need to be fast enough to scan with.
+class PikeVM {
+public:
+    explicit PikeVM(const NFA& nfa);
+    ~PikeVM() = default;
+
+    // fills slots (nfa.slot_count() of them) for the match of line[start, end): slots[2k] and slots[2k + 1]
+    // are where group k starts and ends in line, npos if it didn't take part, and group 0 is start and end
+    // end anchors mean the end of line and start anchors its start, like everywhere else
+    // false if no pattern matches exactly that much of line
+    bool captures(std::string_view line, size_t start, size_t end, vector<size_t>& slots);
+
+private:
+    // a thread list: the states in priority order, and the slots of each one at slots[state * slot_count]
+    struct Threads {
+        SparseSet states;
+        vector<size_t> slots;
+    };
+
+    const NFA& nfa;
+    uint32_t slot_count;
+    Threads current;
+    Threads next;
+
+    // the slots a thread has while it's following epsilons, and the Saves to undo on the way back out
+    vector<size_t> scratch;
+    struct Frame {
+        // NO_STATE means put value back in slot
+        StateId id;
+        uint32_t slot;
+        size_t value;
+    };
+    vector<Frame> stack;
+
+    void add_thread(Threads& threads, StateId id, size_t pos);
+};
@@ -0,0 +1,42 @@
+#include "prefilter.h"
+
+#include <cstring>
+
+namespace {
+    // rough guess at how common a byte is in text and logs, higher is more common
+    int byte_rank(unsigned char ch) {
+        if (ch == ' ') return 255;
+        if (std::strchr("etaoinsr", ch) && ch != 0) return 240;
+        if (ch >= 'a' && ch <= 'z') return 200;
+        if (ch >= '0' && ch <= '9') return 190;
+        if (std::strchr(".,:;-_/=\"'()[]", ch) && ch != 0) return 170;
+        if (ch >= 'A' && ch <= 'Z') return 150;
+        return 50;
+    }
+}
+
+Prefilter::Prefilter(std::string literal, bool exact): literal(std::move(literal)), exact(exact) {
+    for (size_t i = 1; i < this->literal.size(); i++) {
+        if (byte_rank(this->literal[i]) < byte_rank(this->literal[rare_index])) rare_index = i;
+    }
+}
+
+size_t Prefilter::find(std::string_view haystack, size_t from) const {
+    const size_t n = literal.size();
+    if (n == 0) return from <= haystack.size() ? from : std::string_view::npos;
+    if (from > haystack.size() || haystack.size() - from < n) return std::string_view::npos;
+
+    // a candidate is anywhere the rare byte shows up with room for the rest of the literal around it
+    const char* base = haystack.data();
+    const char* p = base + from + rare_index;
+    const char* end = base + haystack.size() - (n - 1 - rare_index);
+    const char rare = literal[rare_index];
+    while (p < end) {
+        p = static_cast<const char*>(std::memchr(p, rare, end - p));
+        if (p == nullptr) break;
+        const char* start = p - rare_index;
+        if (std::memcmp(start, literal.data(), n) == 0) return start - base;
+        p++;
+    }
+    return std::string_view::npos;
+}
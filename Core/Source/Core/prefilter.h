@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+// A literal that has to appear in every match of a pattern, worked out by RegexCompiler::extract_prefilter.
+// Lines that don't contain it can't match, and finding it is a memchr plus a memcmp per candidate,
+// which is a lot cheaper than stepping the automaton through every byte.
+class Prefilter {
+public:
+    Prefilter() = default;
+    Prefilter(std::string literal, bool exact);
+    ~Prefilter() = default;
+
+    // no literal means every line has to go through the automaton
+    bool empty() const { return literal.empty(); }
+    // true when the pattern is nothing but the literal, so finding it is the same as matching
+    bool is_exact() const { return exact; }
+    const std::string& get_literal() const { return literal; }
+
+    // position of the first occurrence of the literal in haystack at or after from, or npos
+    size_t find(std::string_view haystack, size_t from = 0) const;
+
+private:
+    std::string literal;
+    bool exact = false;
+    // we memchr for the least common byte of the literal rather than the first one
+    size_t rare_index = 0;
+};
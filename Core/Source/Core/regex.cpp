@@ -0,0 +1,72 @@
+#include "regex.h"
+
+#include "regex_compiler.h"
+#include "token.h"
+
+Regex::Regex(const vector<string>& patterns, bool spans) {
+    using clock = std::chrono::steady_clock;
+    const clock::time_point start = clock::now();
+    RegexCompiler compiler;
+    if (patterns.size() == 1) {
+        vector<Token> tokens = compiler.parse(patterns[0]);
+        const clock::time_point parsed_at = clock::now();
+        nfa = compiler.compile(tokens);
+        if (spans) {
+            vector<vector<Token>> parsed = {tokens};
+            reverse_nfa = std::make_unique<NFA>(compiler.compile_reverse(parsed));
+        }
+        // lines without the pattern's required literal get skipped before they reach the automaton
+        // (and a pattern that is just a literal doesn't need the automaton at all)
+        prefilter = compiler.extract_prefilter(tokens);
+        // small patterns get simulated a word at a time
+        if (BitParallel::fits(nfa)) bit_parallel = std::make_unique<BitParallel>(nfa);
+        finish_stats(start, parsed_at);
+        return;
+    }
+
+    // several patterns all go into one nfa, so every line only gets scanned once
+    vector<vector<Token>> parsed;
+    vector<string> literal_set;
+    bool all_literals = true;
+    for (const string& pattern : patterns) {
+        parsed.push_back(compiler.parse(pattern));
+        string literal;
+        if (all_literals && RegexCompiler::extract_literal(parsed.back(), literal)) {
+            literal_set.push_back(std::move(literal));
+        }
+        else {
+            all_literals = false;
+        }
+    }
+    const clock::time_point parsed_at = clock::now();
+    nfa = compiler.compile(parsed);
+    if (spans) reverse_nfa = std::make_unique<NFA>(compiler.compile_reverse(parsed));
+
+    // a set of plain literals is a dictionary search, which aho-corasick does in one pass without the nfa
+    if (all_literals) literals = std::make_unique<AhoCorasick>(literal_set);
+    finish_stats(start, parsed_at);
+}
+
+void Regex::finish_stats(std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point parsed_at) {
+    using seconds = std::chrono::duration<double>;
+    compile_stats.parse_seconds = seconds(parsed_at - start).count();
+    compile_stats.compile_seconds = seconds(std::chrono::steady_clock::now() - parsed_at).count();
+    compile_stats.patterns = nfa.pattern_count();
+    compile_stats.nfa_states = nfa.size();
+    compile_stats.reverse_nfa_states = reverse_nfa ? reverse_nfa->size() : 0;
+    compile_stats.byte_classes = nfa.equivalence_classes().size();
+}
+
+string Regex::save_dfa() const {
+    DenseDFA dfa(nfa);
+    return dfa.serialize(prefilter);
+}
+
+Regex Regex::load_dfa(std::string_view bytes) {
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    Regex regex;
+    regex.dense_dfa = std::make_unique<DenseDFA>(DenseDFA::load(bytes, regex.prefilter));
+    // there's nothing to parse, loading is all the compiling there is
+    regex.finish_stats(start, start);
+    return regex;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "aho_corasick.h"
+#include "bit_parallel.h"
+#include "dense_dfa.h"
+#include "nfa.h"
+#include "prefilter.h"
+#include "stats.h"
+
+using std::vector, std::string;
+
+// Everything compiled from the patterns, which never changes once it's built, so threads can share it.
+// The nfa is always there. The other engines only get built when the patterns suit them, and Matcher
+// picks whichever is fastest for the patterns it's given.
+class Regex {
+public:
+    // parse and compile the patterns, a pattern's id is its index. throws std::logic_error on a bad pattern
+    // spans also compiles them backwards, which Matcher needs to find where in a line the matches are
+    explicit Regex(const vector<string>& patterns, bool spans = false);
+    ~Regex() = default;
+
+    Regex(const Regex&) = delete;
+    Regex& operator=(const Regex&) = delete;
+    Regex(Regex&&) = default;
+    Regex& operator=(Regex&&) = default;
+
+    // build the whole dfa for the patterns and return it (and the prefilter) as the bytes of a file for load_dfa
+    // throws std::runtime_error if the dfa would be too big
+    string save_dfa() const;
+    // use a file save_dfa wrote, without the patterns. bytes has to outlive the Regex (it's used in place)
+    // throws std::runtime_error if the file is bad
+    static Regex load_dfa(std::string_view bytes);
+
+    const NFA& get_nfa() const { return nfa; }
+    const Prefilter& get_prefilter() const { return prefilter; }
+    // only set when there are several patterns and every one of them is a plain literal
+    const AhoCorasick* get_literals() const { return literals.get(); }
+    // only set when the nfa has few enough positions to simulate in one word
+    const BitParallel* get_bit_parallel() const { return bit_parallel.get(); }
+    // only set when the patterns came from a saved dfa, in which case the nfa is empty
+    const DenseDFA* get_dense_dfa() const { return dense_dfa.get(); }
+    // the patterns compiled backwards, only set when the Regex was built with spans
+    const NFA* get_reverse_nfa() const { return reverse_nfa.get(); }
+    // how long parsing and compiling took and how big the automata came out, for --stats
+    const CompileStats& get_compile_stats() const { return compile_stats; }
+
+private:
+    // for load_dfa, which fills in the members itself
+    Regex() = default;
+
+    NFA nfa;
+    Prefilter prefilter;
+    std::unique_ptr<AhoCorasick> literals;
+    std::unique_ptr<BitParallel> bit_parallel;
+    std::unique_ptr<DenseDFA> dense_dfa;
+    std::unique_ptr<NFA> reverse_nfa;
+    CompileStats compile_stats;
+
+    void finish_stats(std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point parsed_at);
+};
@@ -1,10 +1,14 @@
 //
 // Created by Caroline Millan on 16/09/2025.
 //
-// parses a regex string into a vector of tokens in postfix form
+// compiles parsed patterns (postfix tokens, from RegexParser) into an NFA, and works out their prefilters
 
+#include <algorithm>
 #include <stack>
+#include <stdexcept>
 #include <string>
+#include <unordered_map>
+#include <utility>
 
 #include "regex_compiler.h"
 
@@ -13,285 +17,49 @@
 using std::stack;
 using std::string;
 
-constexpr std::optional<char> EPSILON = std::nullopt;
-
-vector<Token> RegexCompiler::parse(const string& pattern)
-{
-    tokenize(pattern);
-    add_concats();
-    to_postfix();
-
-    return postfix_tokens;
+/* --------------------- COMPILE TO NFA -------------------- */
+NFA RegexCompiler::compile(vector<Token>& tokens) {
+        NFA nfa = NFA();
+        add_pattern(nfa, tokens);
+        nfa.finish();
+        return nfa;
 }
 
-
-/* -------------------- TOKENIZE ---------------------- */
-
-void RegexCompiler::tokenize(const string &pattern) {
-    // tokenizes the pattern string
-
-    // make sure we're starting with an empty list of tokens
-    tokens.clear();
-
-    // loop through the pattern
-    for (int i = 0 ; i < pattern.size() ; i++) {
-        char ch = pattern[i];
-
-        if (ch == '\\') {
-            // look at the next char that's being escaped, that will give you the token::KIND
-            if (i+1 >= pattern.size()) {
-                // then it's the last char and it's not escaping anything, so just add the literal
-                Token t;
-                t.ch = ch;
-                t.kind = Token::KIND::Literal;
-                tokens.push_back(t);
-                continue;
-            }
-            else {
-                parse_escaped(pattern[i+1]);
-                // need to skip the escaped character, so add one to i
-                i++;
-                continue;
-            }
-        }
-        else if (ch == '[') {
-            if (i+1 >= pattern.size()-1) {
-                // then it's the last char and it's not escaping anything, so just add the literal
-                Token t;
-                t.ch = ch;
-                t.kind = Token::KIND::Literal;
-                tokens.push_back(t);
-                continue;
-            }
-            else {
-                i = parse_char_class(pattern, i+1);
-            }
-        }
-        else if (ch == '*') {
-            Token t;
-            t.kind = Token::KIND::Star;
-            tokens.push_back(t);
-        }
-
-        else if (ch == '+') {
-            Token t;
-            t.kind = Token::KIND::Plus;
-            tokens.push_back(t);
-        }
-        else if (ch == '?') {
-            Token t;
-            t.kind = Token::KIND::Question;
-            tokens.push_back(t);
-        }
-        else if (ch == '|') {
-            Token t;
-            t.kind = Token::KIND::Alt;
-            tokens.push_back(t);
-        }
-        else if (ch == '(') {
-            Token t;
-            t.kind = Token::KIND::LParen;
-            tokens.push_back(t);
-        }
-        else if (ch == ')') {
-            Token t;
-            t.kind = Token::KIND::RParen;
-            tokens.push_back(t);
-        }
-        else if (ch == '.') {
-            parse_dot();
-        }
-	else if (ch == '^') {
-            Token t;
-            t.kind = Token::KIND::StartAnchor;
-            tokens.push_back(t);
-	}
-	else if (ch == '$') {
-            Token t;
-            t.kind = Token::KIND::EndAnchor;
-            tokens.push_back(t);
-	}
-        else {
-            Token t;
-            t.ch = ch;
-            t.kind = Token::KIND::Literal;
-            tokens.push_back(t);
-        }
-    }
-};
-
-void RegexCompiler::parse_escaped(const char ch) {
-    // want to match ch to any of the regex things we support, else just save the literal
-    Token t;
-    switch (ch) {
-        case 'd':
-            // matches all digits ascii 48-57
-            t.kind = Token::KIND::CharClass;
-            t.add_range_to_char_class('0','9');
-            break;
-        case 'w':
-            // matches all alphanumeric chars
-            t.kind = Token::KIND::CharClass;
-            t.add_range_to_char_class('0','9');
-            t.add_range_to_char_class('a','z');
-            t.add_range_to_char_class('A','Z');
-            t.add_to_char_class('_');
-            break;
-	case 's':
-		// matches all whitespace
-		t.kind = Token::KIND::CharClass;
-		t.add_to_char_class(' ');
-		t.add_to_char_class('\n');
-		t.add_to_char_class('\t');
-		t.add_to_char_class('\r');
-		t.add_to_char_class('\v');
-		t.add_to_char_class('\f');
-		break;
-        default:
-            t.ch = ch;
-            t.kind = Token::KIND::Literal;
-            break;
-    }
-    tokens.push_back(t);
-};
-
-int RegexCompiler::parse_char_class(const string &pattern, int i) {
-    // create a token for char class [] or [^] starting at pattern[i]
-    // two passes -- first one to find the ], second one if you don't find it and need to use a literal instead
-    // for now take everything in the character class as a literal character, no escapes or anything
-    Token t;
-    bool closed = false;
-    int original_index = i;
-
-    // check for a negative character class
-    if (pattern[i] == '^') {
-        t.set_neg_char_class();
-    }
-
-    // loop through pattern until you find the ]
-    for (i; i < pattern.size(); i++) {
-        if (pattern[i] == ']') {
-            closed = true;
-            t.kind = Token::KIND::CharClass;
-            tokens.push_back(t);
-            break;
-        }
-        else {
-            t.add_to_char_class(pattern[i]);
-        }
-    }
-    if (!closed) {
-        // second pass to add a literal instead
-        for (int j = original_index; j < pattern.size(); j++) {
-            Token t_lit;
-            t_lit.kind = Token::KIND::Literal;
-            t_lit.ch = pattern[j];
-            tokens.push_back(t_lit);
-        }
-    }
-    return i;
-};
-
-void RegexCompiler::parse_dot() {
-    Token t;
-    t.kind = Token::KIND::CharClass;
-    char before_newline = '\n'-1;
-    char after_newline = '\n'+1;
-    t.add_range_to_char_class(0, before_newline);
-    t.add_range_to_char_class(after_newline, -1);
-    tokens.push_back(t);
-};
-
-void RegexCompiler::add_concats() {
-    // adds concats to tokens
-    Token previous;
-    bool first = true;
-    for (Token current : tokens) {
-        if (!first && should_concat(previous, current)) {
-            Token t;
-            t.kind = Token::KIND::Concat;
-            concat_tokens.push_back(t);
+NFA RegexCompiler::compile(vector<vector<Token>>& patterns) {
+        // every pattern gets its own fragment and its own Match, all in one program, so one pass over a line checks them all
+        NFA nfa = NFA();
+        for (vector<Token>& tokens : patterns) {
+                add_pattern(nfa, tokens);
         }
-        concat_tokens.push_back(current);
-        previous = current;
-        first = false;
-    }
-};
-
-bool RegexCompiler::should_concat(const Token& previous, const Token& current) {
-    // may want to check edge cases in future, if you expand it
-    return (previous.is_operand() || previous.kind == Token::KIND::RParen || (previous.kind == Token::KIND::Star || previous.kind == Token::KIND::Plus || previous.kind == Token::KIND::Question) )
-    && (current.is_operand() || current.kind == Token::KIND::LParen);
+        nfa.finish();
+        return nfa;
 }
 
-/* --------------------- TO POSTFIX -------------------- */
-
-void RegexCompiler::to_postfix() {
-    // gets tokens into postfix format using shunting-yard algorithm
-
-    //make sure we have a fresh postfix_tokens
-    postfix_tokens.clear();
-
-    // make a stack to store the operators on
-    stack<Token> st;
-
-    for (const Token& token : concat_tokens) {
-        if (token.is_operand() || token.is_postfix_unary() || token.is_anchor()) {
-            postfix_tokens.push_back(token);
-            continue;
-        }
-        else if (token.is_operator()) {
-            while (!st.empty() && st.top().is_operator()) {
-                // all your operators are left associative. If you add in right associative operators then you'll need a check here
-                if (Token::get_precedence(st.top().kind) >= Token::get_precedence(token.kind)) {
-                    postfix_tokens.push_back(st.top());
-                    st.pop();
-                }
-                else break;
-            }
-            st.push(token);
-        }
-        else if (token.kind == Token::KIND::LParen) {
-            st.push(token);
-        }
-        else if (token.kind == Token::KIND::RParen) {
-            // pop everything until you reach an LParen, then discard both parens
-            while (!st.empty() && st.top().kind != Token::KIND::LParen) {
-                Token el = st.top();
-                st.pop();
-                postfix_tokens.push_back(el);
-            }
+NFA RegexCompiler::compile_reverse(vector<vector<Token>>& patterns) {
+        // same program shape as compile, pattern ids line up with it
+        NFA nfa = NFA();
+        for (vector<Token>& tokens : patterns) {
+                add_pattern(nfa, tokens, true);
         }
-        //st.push(token);
-    }
-
-    // add the remaining tokens from the stack
-    while (!st.empty()) {
-        Token t = st.top();
-        st.pop();
-        if (t.kind != Token::KIND::LParen && t.kind != Token::KIND::RParen) postfix_tokens.push_back(t);
-    }
-};
+        nfa.finish();
+        return nfa;
+}
 
-/* --------------------- COMPILE TO NFA -------------------- */
-NFA RegexCompiler::compile(vector<Token>& tokens) {
+void RegexCompiler::add_pattern(NFA& nfa, vector<Token>& tokens, bool reverse) {
         // Thompson's construction
+        // every fragment's accept state is a Jmp with no target yet, which gets patched when the fragment is used
         stack<NFAFragment> fragments;
-        //vector<unique_ptr<State>> states;
-
-        NFA nfa = NFA();
+        bool start_anchor = false;
+        bool end_anchor = false;
 
         for (Token& token : tokens) {
                 // rules go here
                 switch (token.kind) {
                 case Token::KIND::Literal:
                         {
-                                // add start and accept states to nfa
-                                State* start = nfa.new_state(false);
-                                State* accept = nfa.new_state(true);
-
-                                // add transition to start state
-                                start->transitions.emplace_back(token.ch, accept);
+                                // add start and accept states to nfa, with a transition on the char between them
+                                StateId accept = nfa.add_inst(Inst::jmp(NO_STATE));
+                                StateId start = nfa.add_inst(Inst::byte(token.ch, accept));
 
                                 // add fragment to fragments stack
                                 fragments.emplace(start, accept);
@@ -300,15 +68,24 @@ NFA RegexCompiler::compile(vector<Token>& tokens) {
                         }
                 case Token::KIND::CharClass:
                         {
-                                // add start and accept states to nfa
-                                State* start = nfa.new_state(false);
-                                State* accept = nfa.new_state(true);
-
-                                // add transition to start state for each char
+                                // the whole class is a single transition: a ByteRange if the set bits are one run, otherwise a bitmap
+                                const ByteSet& set = char_class(token.class_index);
+                                int first = -1, last = -1, runs = 0;
                                 for (int c = 0; c < 256; c++) {
-                                        if (token.bitmap[c]) {
-                                                start->transitions.emplace_back(static_cast<unsigned char>(c), accept);
-                                        }
+                                        if (!set.contains(c)) continue;
+                                        if (c != last + 1 || first == -1) runs++;
+                                        if (first == -1) first = c;
+                                        last = c;
+                                }
+
+                                StateId accept = nfa.add_inst(Inst::jmp(NO_STATE));
+                                StateId start;
+                                if (runs == 1) {
+                                        start = nfa.add_inst(Inst::range(first, last, accept));
+                                }
+                                else {
+                                        // this includes the empty class, which can never match
+                                        start = nfa.add_inst(Inst::byte_class(nfa.add_class(set), accept));
                                 }
 
                                 // add fragment to fragments stack
@@ -327,11 +104,13 @@ NFA RegexCompiler::compile(vector<Token>& tokens) {
                                 fragments.pop();
                                 NFAFragment a = fragments.top();
                                 fragments.pop();
+                                // backwards, b comes first
+                                if (reverse) std::swap(a, b);
 
                                 // now we concat them to get a new fragment
 
                                 // we want an epsilon transition between a's accept state and b's start state
-                                a.accept->transitions.emplace_back(EPSILON, b.start);
+                                nfa.inst(a.accept).out = b.start;
 
                                 // add the new fragment to fragments
                                 fragments.emplace(a.start, b.accept);
@@ -343,22 +122,18 @@ NFA RegexCompiler::compile(vector<Token>& tokens) {
                                 // A|B accepts when there is either A or B
                                 if (fragments.size() < 2) throw std::logic_error("Malformed postfix expression: alt needs 2 operands");
 
-                                // add start and accept states to nfa
-                                State* start = nfa.new_state(false);
-                                State* accept = nfa.new_state(true);
-
                                 NFAFragment b = fragments.top();
                                 fragments.pop();
                                 NFAFragment a = fragments.top();
                                 fragments.pop();
 
-                                // add epsilon transitions from start to a.start and b.start
-                                start->transitions.emplace_back(EPSILON, a.start);
-                                start->transitions.emplace_back(EPSILON, b.start);
+                                // add start and accept states to nfa, with epsilon transitions from start to a.start and b.start
+                                StateId accept = nfa.add_inst(Inst::jmp(NO_STATE));
+                                StateId start = nfa.add_inst(Inst::split(a.start, b.start));
 
                                 // add epsilon transitions from a.accept and b.accept to accept
-                                a.accept->transitions.emplace_back(EPSILON, accept);
-                                b.accept->transitions.emplace_back(EPSILON, accept);
+                                nfa.inst(a.accept).out = accept;
+                                nfa.inst(b.accept).out = accept;
 
                                 // add fragment to fragments stack
                                 fragments.emplace(start, accept);
@@ -370,20 +145,15 @@ NFA RegexCompiler::compile(vector<Token>& tokens) {
                                 // A* accepts when there are 0 or more A's
                                 if (fragments.empty()) throw std::logic_error("Malformed postfix expression: star needs an operand");
 
-                                // add start and accept states to nfa
-                                State* start = nfa.new_state(false);
-                                State* accept = nfa.new_state(true);
-
                                 NFAFragment a = fragments.top();
                                 fragments.pop();
 
-                                // add epsilon transitions from start to a.start and accept (accepts 0)
-                                start->transitions.emplace_back(EPSILON, a.start);
-                                start->transitions.emplace_back(EPSILON, accept);
+                                // add start and accept states to nfa, with epsilon transitions from start to a.start and accept (accepts 0)
+                                StateId accept = nfa.add_inst(Inst::jmp(NO_STATE));
+                                StateId start = nfa.add_inst(Inst::split(a.start, accept));
 
                                 // add epsilon transitions from a.accept to a.start and accept (accepts 1+)
-                                a.accept->transitions.emplace_back(EPSILON, a.start);
-                                a.accept->transitions.emplace_back(EPSILON, accept);
+                                nfa.inst(a.accept) = Inst::split(a.start, accept);
 
                                 // add fragment to fragments stack
                                 fragments.emplace(start, accept);
@@ -395,19 +165,15 @@ NFA RegexCompiler::compile(vector<Token>& tokens) {
                                 // A? is equiv to (nothing)|A
                                 if (fragments.empty()) throw std::logic_error("Malformed postfix expression: question needs an operand");
 
-                                // add start and accept states to nfa
-                                State* start = nfa.new_state(false);
-                                State* accept = nfa.new_state(true);
-
                                 NFAFragment a = fragments.top();
                                 fragments.pop();
 
-                                // add epsilon transitions from start to a.start and accept (accepts 0)
-                                start->transitions.emplace_back(EPSILON, a.start);
-                                start->transitions.emplace_back(EPSILON, accept);
+                                // add start and accept states to nfa, with epsilon transitions from start to a.start and accept (accepts 0)
+                                StateId accept = nfa.add_inst(Inst::jmp(NO_STATE));
+                                StateId start = nfa.add_inst(Inst::split(a.start, accept));
 
                                 // add epsilon transitions from a.accept to accept (accepts 1)
-                                a.accept->transitions.emplace_back(EPSILON, accept);
+                                nfa.inst(a.accept).out = accept;
 
                                 // add fragment to fragments stack
                                 fragments.emplace(start, accept);
@@ -418,44 +184,300 @@ NFA RegexCompiler::compile(vector<Token>& tokens) {
                         {
                                 if (fragments.empty()) throw std::logic_error("Malformed postfix expression: plus needs an operand");
 
-                                // add start and accept states to nfa
-                                State* start = nfa.new_state(false);
-                                State* accept = nfa.new_state(true);
-
                                 NFAFragment a = fragments.top();
                                 fragments.pop();
 
-                                // add epsilon transitions from start to a.start and accept (accepts a.start only)
-                                start->transitions.emplace_back(EPSILON, a.start);
+                                // add an accept state to nfa, the start state is just a.start
+                                StateId accept = nfa.add_inst(Inst::jmp(NO_STATE));
 
                                 // add epsilon transitions from a.accept to a.start and accept (accepts 1+)
-                                a.accept->transitions.emplace_back(EPSILON, a.start);
-                                a.accept->transitions.emplace_back(EPSILON, accept);
+                                nfa.inst(a.accept) = Inst::split(a.start, accept);
 
                                 // add fragment to fragments stack
+                                fragments.emplace(a.start, accept);
+
+                                break;
+                        }
+                case Token::KIND::Group:
+                        {
+                                // (A) is A between two Saves, which record where the group starts and ends
+                                // they're epsilons, so only the Pike VM pays any attention to them
+                                if (fragments.empty()) throw std::logic_error("Malformed postfix expression: group needs an operand");
+
+                                NFAFragment a = fragments.top();
+                                fragments.pop();
+
+                                StateId accept = nfa.add_inst(Inst::jmp(NO_STATE));
+                                nfa.inst(a.accept) = Inst::save(2 * token.group + 1, accept);
+                                StateId start = nfa.add_inst(Inst::save(2 * token.group, a.start));
                                 fragments.emplace(start, accept);
 
+                                break;
+                        }
+                case Token::KIND::Repeat:
+                        {
+                                if (fragments.empty()) throw std::logic_error("Malformed postfix expression: repeat needs an operand");
+
+                                NFAFragment a = fragments.top();
+                                fragments.pop();
+                                fragments.push(repeat_fragment(nfa, a, token.repeat_min, token.repeat_max));
+
                                 break;
                         }
                 case Token::KIND::StartAnchor: {
-			nfa.start_anchor = true;
+			start_anchor = true;
 		break;
 			}
                 case Token::KIND::EndAnchor: {
-			nfa.end_anchor = true;
+			end_anchor = true;
 		break;
 			}
                 default: { break; }
                 }
         }
 
-        // final fragment on stack will be the start and accept states for the NFA
+        // final fragment on stack will be the start and accept states for the pattern
         if (fragments.size() == 1) {
                 NFAFragment final = fragments.top();
-                nfa.add_final_fragment(final);
-                return nfa;
+                // the start of a reversed line is its end
+                if (reverse) std::swap(start_anchor, end_anchor);
+                nfa.add_pattern(final, start_anchor, end_anchor);
         }
         else {
                 throw std::logic_error("Malformed NFA: no final fragment for start and accept states");
         }
 }
+
+NFAFragment RegexCompiler::copy_fragment(NFA& nfa, NFAFragment fragment) {
+        // a fragment is everything reachable from its start, and its accept is the only state with nowhere to go yet
+        // so copying is a walk from the start, remapping the targets as we go
+        vector<StateId> old_states;
+        std::unordered_map<StateId, StateId> copies;
+        stack<StateId> pending;
+        pending.push(fragment.start);
+        while (!pending.empty()) {
+                StateId id = pending.top();
+                pending.pop();
+                if (id == NO_STATE || copies.count(id)) continue;
+                copies[id] = nfa.add_inst(nfa.inst(id));
+                old_states.push_back(id);
+
+                const Inst& inst = nfa.inst(id);
+                pending.push(inst.out);
+                // a Class keeps its class index in out1, only a Split has a second target
+                if (inst.op == Inst::OP::Split) pending.push(inst.out1);
+        }
+
+        for (StateId id : old_states) {
+                Inst& copy = nfa.inst(copies[id]);
+                if (copy.out != NO_STATE) copy.out = copies[copy.out];
+                if (copy.op == Inst::OP::Split) copy.out1 = copies[copy.out1];
+        }
+        return {copies[fragment.start], copies[fragment.accept]};
+}
+
+NFAFragment RegexCompiler::repeat_fragment(NFA& nfa, NFAFragment a, int min, int max) {
+        // A{n,m} is n copies of A followed by m - n optional ones, nested as (A(A(A)?)?)? rather than A?A?A?
+        // so a skipped copy jumps straight to the end instead of through every later copy
+        // that keeps the nfa (and the sets of states the simulations track) linear in m
+        int copies = std::max(min, max == Token::UNBOUNDED ? 1 : max);
+        if (copies > MAX_REPEAT) throw std::logic_error("Invalid repetition: too many copies");
+
+        // copy everything before wiring any of it up, the copies are of A as it is now
+        vector<NFAFragment> parts = {a};
+        for (int i = 1; i < copies; i++) {
+                uint32_t before = nfa.size();
+                parts.push_back(copy_fragment(nfa, a));
+                // nested repeats multiply, so check the whole thing will fit once we know how big a copy is
+                if (i == 1 && size_t{nfa.size() - before} * copies > MAX_PROGRAM_SIZE) {
+                        throw std::logic_error("Invalid repetition: the pattern would be too big");
+                }
+        }
+
+        // the empty string: a Jmp to the accept, so start and accept are different states like every other fragment
+        // A itself is left unreachable, but its accept still needs a target (the closures follow every Jmp)
+        if (copies == 0) {
+                StateId accept = nfa.add_inst(Inst::jmp(NO_STATE));
+                nfa.inst(a.accept).out = accept;
+                return {nfa.add_inst(Inst::jmp(accept)), accept};
+        }
+
+        // the optional tail, built from the innermost copy out
+        NFAFragment tail;
+        if (max == Token::UNBOUNDED) {
+                // A{n,} is A{n-1}A+, or A* when n is 0
+                NFAFragment last = parts.back();
+                StateId accept = nfa.add_inst(Inst::jmp(NO_STATE));
+                nfa.inst(last.accept) = Inst::split(last.start, accept);
+                tail = min == 0 ? NFAFragment(nfa.add_inst(Inst::split(last.start, accept)), accept) : NFAFragment(last.start, accept);
+                parts.pop_back();
+        }
+        else {
+                for (int i = max - 1; i >= min; i--) {
+                        NFAFragment part = parts[i];
+                        StateId accept = nfa.add_inst(Inst::jmp(NO_STATE));
+                        if (tail.start != NO_STATE) {
+                                nfa.inst(part.accept).out = tail.start;
+                                nfa.inst(tail.accept).out = accept;
+                        }
+                        else {
+                                nfa.inst(part.accept).out = accept;
+                        }
+                        tail = NFAFragment(nfa.add_inst(Inst::split(part.start, accept)), accept);
+                }
+                parts.resize(min);
+        }
+
+        // then the n required copies in front of it
+        NFAFragment result = tail;
+        for (int i = static_cast<int>(parts.size()) - 1; i >= 0; i--) {
+                if (result.start == NO_STATE) {
+                        result = parts[i];
+                        continue;
+                }
+                nfa.inst(parts[i].accept).out = result.start;
+                result.start = parts[i].start;
+        }
+        return result;
+}
+
+/* --------------------- PREFILTER -------------------- */
+
+namespace {
+    // what we know about the literals in every match of a sub-expression
+    struct LiteralInfo {
+        bool exact = false; // the sub-expression only ever matches one string, which is prefix (== suffix == required)
+        string prefix; // every match starts with this
+        string suffix; // every match ends with this
+        string required; // every match contains this
+    };
+
+    LiteralInfo literal_info(char ch) {
+        // lines never contain a newline, and a literal with one in it would let a hit span two lines
+        if (ch == '\n') return {};
+        string s(1, ch);
+        return {true, s, s, s};
+    }
+
+    // a literal from a repeat gets cut down to this, memchr doesn't get any faster with a longer one
+    constexpr size_t MAX_PREFILTER_LITERAL = 64;
+
+    const string& longest(const string& a, const string& b) {
+        return b.size() > a.size() ? b : a;
+    }
+}
+
+Prefilter RegexCompiler::extract_prefilter(const vector<Token>& tokens) {
+        // walk the postfix tokens like compile does, but build up LiteralInfo instead of NFA fragments
+        stack<LiteralInfo> infos;
+        bool anchored = false;
+
+        for (const Token& token : tokens) {
+                switch (token.kind) {
+                case Token::KIND::Literal:
+                        infos.push(literal_info(token.ch));
+                        break;
+                case Token::KIND::CharClass:
+                        {
+                                // a class with a single byte in it is really a literal
+                                const ByteSet& set = char_class(token.class_index);
+                                int only = 0;
+                                while (only < 255 && !set.contains(only)) only++;
+                                infos.push(set.count() == 1 ? literal_info(static_cast<char>(only)) : LiteralInfo{});
+                                break;
+                        }
+                case Token::KIND::Concat:
+                        {
+                                if (infos.size() < 2) throw std::logic_error("Malformed postfix expression: concat needs 2 operands");
+                                LiteralInfo b = std::move(infos.top());
+                                infos.pop();
+                                LiteralInfo a = std::move(infos.top());
+                                infos.pop();
+
+                                LiteralInfo info;
+                                info.exact = a.exact && b.exact;
+                                info.prefix = a.exact ? a.prefix + b.prefix : a.prefix;
+                                info.suffix = b.exact ? a.suffix + b.suffix : b.suffix;
+                                // a's suffix runs straight into b's prefix, so that joined up is required too
+                                info.required = longest(longest(a.required, b.required), a.suffix + b.prefix);
+                                if (info.exact) info.required = info.prefix;
+                                infos.push(std::move(info));
+                                break;
+                        }
+                case Token::KIND::Plus:
+                        {
+                                // one or more copies, so whatever one copy needs is still needed
+                                if (infos.empty()) throw std::logic_error("Malformed postfix expression: plus needs an operand");
+                                infos.top().exact = false;
+                                break;
+                        }
+                case Token::KIND::Alt:
+                        {
+                                // either side can match, so neither side's literals are required
+                                if (infos.size() < 2) throw std::logic_error("Malformed postfix expression: alt needs 2 operands");
+                                infos.pop();
+                                infos.top() = LiteralInfo{};
+                                break;
+                        }
+                case Token::KIND::Repeat:
+                        {
+                                if (infos.empty()) throw std::logic_error("Malformed postfix expression: repeat needs an operand");
+                                LiteralInfo& info = infos.top();
+                                if (token.repeat_min == 0) {
+                                        // zero copies is allowed, so nothing is required
+                                        info = LiteralInfo{};
+                                }
+                                else if (info.exact) {
+                                        // the required copies spell out a literal, which we can cap without it stopping being required
+                                        string copies;
+                                        for (int i = 0; i < token.repeat_min && copies.size() < MAX_PREFILTER_LITERAL; i++) copies += info.prefix;
+                                        bool whole = copies.size() == info.prefix.size() * token.repeat_min;
+                                        // once it's been cut down it's only part of the pattern, so it can't be exact any more
+                                        // (and a Concat mustn't tack the next literal on to the cut off end)
+                                        info.exact = whole && token.repeat_max == token.repeat_min && copies.size() <= MAX_PREFILTER_LITERAL;
+                                        // cutting the front of it off would change the suffix, so that falls back to one copy
+                                        if (whole) info.suffix = copies;
+                                        if (copies.size() > MAX_PREFILTER_LITERAL) copies.resize(MAX_PREFILTER_LITERAL);
+                                        info.prefix = info.required = copies;
+                                }
+                                else {
+                                        // at least two copies means one copy's suffix runs into the next one's prefix
+                                        info.exact = false;
+                                        if (token.repeat_min >= 2) info.required = longest(info.required, info.suffix + info.prefix);
+                                }
+                                break;
+                        }
+                case Token::KIND::Star:
+                case Token::KIND::Question:
+                        {
+                                // zero copies is allowed, so nothing is required
+                                if (infos.empty()) throw std::logic_error("Malformed postfix expression: star/question needs an operand");
+                                infos.top() = LiteralInfo{};
+                                break;
+                        }
+                case Token::KIND::StartAnchor:
+                case Token::KIND::EndAnchor:
+                        anchored = true;
+                        break;
+                default:
+                        break;
+                }
+        }
+
+        if (infos.size() != 1) return Prefilter();
+        const LiteralInfo& info = infos.top();
+        // with anchors, finding the literal somewhere in the line isn't enough to say it matches
+        return Prefilter(info.required, info.exact && !anchored);
+}
+
+bool RegexCompiler::extract_literal(const vector<Token>& tokens, string& literal) {
+        // in postfix, a plain literal is its characters with Concats (and maybe Groups) mixed in
+        literal.clear();
+        for (const Token& token : tokens) {
+                if (token.kind == Token::KIND::Concat || token.kind == Token::KIND::Group) continue;
+                // a newline in the literal would let a hit span two lines
+                if (token.kind != Token::KIND::Literal || token.ch == '\n') return false;
+                literal.push_back(token.ch);
+        }
+        return !literal.empty();
+}
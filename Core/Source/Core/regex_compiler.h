@@ -4,34 +4,66 @@
 
 #pragma once
 
+#include <string>
+#include <unordered_map>
 #include <vector>
+#include "byte_set.h"
 #include "token.h"
 #include "nfa.h"
+#include "prefilter.h"
+#include "regex_parser.h"
 
 using std::vector, std::string;
 
+// the compiler's character classes, with a hash map to find repeats (thousands of patterns can go through one compiler)
+class HashedClasses {
+public:
+    uint32_t add(const ByteSet& set) {
+        auto [it, added] = ids.try_emplace(set, sets.size());
+        if (added) sets.push_back(set);
+        return it->second;
+    }
+    const ByteSet& operator[](uint32_t index) const { return sets[index]; }
+
+private:
+    vector<ByteSet> sets;
+    std::unordered_map<ByteSet, uint32_t, ByteSetHash> ids;
+};
+
 class RegexCompiler {
 public:
+    // the biggest bound allowed in {n,m}, every repeat is a copy of the sub-expression
+    static constexpr int MAX_REPEAT = RegexParser<HashedClasses>::MAX_REPEAT;
+    // and the most instructions repeats can blow a pattern up to
+    static constexpr size_t MAX_PROGRAM_SIZE = 1 << 20;
+
     RegexCompiler() = default;
     ~RegexCompiler() = default;
-    vector<Token> parse(const string& pattern);
+    // the tokens' character classes live in this compiler, so compile them with the same one
+    vector<Token> parse(const string& pattern) { return parser.parse(pattern); }
     // compile to NFA
     NFA compile(vector<Token>& tokens);
+    // compile several patterns (each one parsed separately) into one NFA, pattern ids are their indexes
+    NFA compile(vector<vector<Token>>& patterns);
+    // compile the patterns backwards, so the NFA matches the reverse of whatever they match
+    // (concatenations run right to left and ^ and $ swap places). running it from the end of a line finds where matches start
+    NFA compile_reverse(vector<vector<Token>>& patterns);
+    // find a literal every match has to contain, from the same postfix tokens
+    Prefilter extract_prefilter(const vector<Token>& tokens);
+    // true if the postfix tokens are just literals concatenated together (no classes, operators or anchors),
+    // in which case literal is set to the string they spell out
+    static bool extract_literal(const vector<Token>& tokens, string& literal);
+
+    // the bytes a CharClass token matches
+    const ByteSet& char_class(uint32_t index) const { return parser.char_class(index); }
 
 private:
-    vector<Token> tokens;
-    vector<Token> concat_tokens;
-    vector<Token> postfix_tokens;
-
-    // helper methods
-    void tokenize(const string& pattern);
-    void parse_escaped(const char ch);
-    int parse_char_class(const string& pattern, int i);
-    void parse_dot();
-    void add_concats();
-    static bool should_concat(const Token& previous, const Token& current);
-
-    // convert to postfix notation
-    void to_postfix();
+    RegexParser<HashedClasses> parser;
+
+    // Thompson's construction for one pattern's postfix tokens
+    void add_pattern(NFA& nfa, vector<Token>& tokens, bool reverse = false);
+    // copy a fragment's instructions, for {n,m}
+    static NFAFragment copy_fragment(NFA& nfa, NFAFragment fragment);
+    static NFAFragment repeat_fragment(NFA& nfa, NFAFragment fragment, int min, int max);
 
 };
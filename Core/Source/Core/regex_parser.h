@@ -0,0 +1,423 @@
+#pragma once
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "byte_set.h"
+#include "token.h"
+
+using std::vector;
+
+// The front end of the compiler: tokenize the pattern, put in the concatenations it leaves implicit, then the
+// shunting yard to get the tokens in postfix order.
+// It's all constexpr, so StaticRegex runs exactly this code at compile time and the two can't disagree about what a
+// pattern means. The only thing that differs is where the character classes are kept, which is Classes: anything with
+// a constexpr-if-it-needs-to-be `uint32_t add(const ByteSet&)` that returns the set's index (the same index for the
+// same set) and an operator[] to get it back.
+template <typename Classes>
+class RegexParser {
+public:
+    // the biggest bound allowed in {n,m}, every repeat is a copy of the sub-expression
+    static constexpr int MAX_REPEAT = 1000;
+
+    constexpr RegexParser() = default;
+
+    // the postfix tokens of pattern. throws std::logic_error if the parentheses don't balance or a repeat is too big
+    // (at compile time that's an error, since a throw can't be a constant expression)
+    constexpr vector<Token> parse(std::string_view pattern);
+
+    // the bytes a CharClass token matches
+    constexpr const ByteSet& char_class(uint32_t index) const { return classes[index]; }
+    constexpr const Classes& get_classes() const { return classes; }
+
+private:
+    // builds up the bytes of a character class while tokenizing
+    // a negated class starts with every byte in it and the listed ones get taken out
+    struct ClassBuilder {
+        ByteSet set;
+        bool negate = false;
+
+        constexpr void set_negated() {
+            negate = true;
+            set.insert_all();
+        }
+
+        constexpr void add(unsigned char ch) {
+            if (!negate) set.insert(ch);
+            else set.erase(ch);
+        }
+
+        constexpr void add_range(unsigned char start, unsigned char end) {
+            for (int ch = start; ch <= end; ch++) add(ch);
+        }
+    };
+
+    vector<Token> tokens;
+    vector<Token> concat_tokens;
+    vector<Token> postfix_tokens;
+    // every distinct character class of every pattern parsed so far, which the tokens point into
+    // (most patterns use the same few, like \d and \w, so thousands of patterns still only have a handful)
+    Classes classes;
+    // the operators waiting in to_postfix
+    vector<Token> operators;
+
+    constexpr void tokenize(std::string_view pattern);
+    constexpr void parse_escaped(const char ch);
+    constexpr int parse_char_class(std::string_view pattern, int i);
+    constexpr void parse_dot();
+    constexpr void add_char_class(const ByteSet& set);
+    constexpr int parse_repeat(std::string_view pattern, int i);
+    constexpr void add_concats();
+    static constexpr bool should_concat(const Token& previous, const Token& current);
+
+    // convert to postfix notation
+    constexpr void to_postfix();
+};
+
+template <typename Classes>
+constexpr vector<Token> RegexParser<Classes>::parse(std::string_view pattern)
+{
+    tokenize(pattern);
+    add_concats();
+    to_postfix();
+
+    return postfix_tokens;
+}
+
+
+/* -------------------- TOKENIZE ---------------------- */
+
+template <typename Classes>
+constexpr void RegexParser<Classes>::tokenize(std::string_view pattern) {
+    // tokenizes the pattern string
+
+    // make sure we're starting with an empty list of tokens
+    tokens.clear();
+    // groups are numbered by their '(', left to right
+    int groups = 0;
+
+    // loop through the pattern
+    for (int i = 0 ; i < pattern.size() ; i++) {
+        char ch = pattern[i];
+
+        if (ch == '\\') {
+            // look at the next char that's being escaped, that will give you the token::KIND
+            if (i+1 >= pattern.size()) {
+                // then it's the last char and it's not escaping anything, so just add the literal
+                Token t;
+                t.ch = ch;
+                t.kind = Token::KIND::Literal;
+                tokens.push_back(t);
+                continue;
+            }
+            else {
+                parse_escaped(pattern[i+1]);
+                // need to skip the escaped character, so add one to i
+                i++;
+                continue;
+            }
+        }
+        else if (ch == '[') {
+            if (i+1 >= pattern.size()-1) {
+                // then it's the last char and it's not escaping anything, so just add the literal
+                Token t;
+                t.ch = ch;
+                t.kind = Token::KIND::Literal;
+                tokens.push_back(t);
+                continue;
+            }
+            else {
+                i = parse_char_class(pattern, i+1);
+            }
+        }
+        else if (ch == '*') {
+            Token t;
+            t.kind = Token::KIND::Star;
+            tokens.push_back(t);
+        }
+
+        else if (ch == '+') {
+            Token t;
+            t.kind = Token::KIND::Plus;
+            tokens.push_back(t);
+        }
+        else if (ch == '?') {
+            Token t;
+            t.kind = Token::KIND::Question;
+            tokens.push_back(t);
+        }
+        else if (ch == '|') {
+            Token t;
+            t.kind = Token::KIND::Alt;
+            tokens.push_back(t);
+        }
+        else if (ch == '(') {
+            Token t;
+            t.kind = Token::KIND::LParen;
+            t.group = ++groups;
+            tokens.push_back(t);
+        }
+        else if (ch == ')') {
+            Token t;
+            t.kind = Token::KIND::RParen;
+            tokens.push_back(t);
+        }
+        else if (ch == '.') {
+            parse_dot();
+        }
+        else if (ch == '{') {
+            i = parse_repeat(pattern, i);
+        }
+	else if (ch == '^') {
+            Token t;
+            t.kind = Token::KIND::StartAnchor;
+            tokens.push_back(t);
+	}
+	else if (ch == '$') {
+            Token t;
+            t.kind = Token::KIND::EndAnchor;
+            tokens.push_back(t);
+	}
+        else {
+            Token t;
+            t.ch = ch;
+            t.kind = Token::KIND::Literal;
+            tokens.push_back(t);
+        }
+    }
+};
+
+template <typename Classes>
+constexpr void RegexParser<Classes>::parse_escaped(const char ch) {
+    // want to match ch to any of the regex things we support, else just save the literal
+    ClassBuilder c;
+    switch (ch) {
+        case 'd':
+            // matches all digits ascii 48-57
+            c.add_range('0','9');
+            break;
+        case 'w':
+            // matches all alphanumeric chars
+            c.add_range('0','9');
+            c.add_range('a','z');
+            c.add_range('A','Z');
+            c.add('_');
+            break;
+	case 's':
+		// matches all whitespace
+		c.add(' ');
+		c.add('\n');
+		c.add('\t');
+		c.add('\r');
+		c.add('\v');
+		c.add('\f');
+		break;
+        default:
+            Token t;
+            t.ch = ch;
+            t.kind = Token::KIND::Literal;
+            tokens.push_back(t);
+            return;
+    }
+    add_char_class(c.set);
+};
+
+template <typename Classes>
+constexpr int RegexParser<Classes>::parse_char_class(std::string_view pattern, int i) {
+    // create a token for char class [] or [^] starting at pattern[i]
+    // two passes -- first one to find the ], second one if you don't find it and need to use a literal instead
+    // for now take everything in the character class as a literal character, no escapes or anything
+    ClassBuilder c;
+    bool closed = false;
+    int original_index = i;
+
+    // check for a negative character class
+    if (pattern[i] == '^') {
+        c.set_negated();
+    }
+
+    // loop through pattern until you find the ]
+    for (; i < pattern.size(); i++) {
+        if (pattern[i] == ']') {
+            closed = true;
+            add_char_class(c.set);
+            break;
+        }
+        else {
+            c.add(pattern[i]);
+        }
+    }
+    if (!closed) {
+        // second pass to add a literal instead
+        for (int j = original_index; j < pattern.size(); j++) {
+            Token t_lit;
+            t_lit.kind = Token::KIND::Literal;
+            t_lit.ch = pattern[j];
+            tokens.push_back(t_lit);
+        }
+    }
+    return i;
+};
+
+template <typename Classes>
+constexpr void RegexParser<Classes>::parse_dot() {
+    ClassBuilder c;
+    char before_newline = '\n'-1;
+    char after_newline = '\n'+1;
+    c.add_range(0, before_newline);
+    c.add_range(after_newline, -1);
+    add_char_class(c.set);
+};
+
+template <typename Classes>
+constexpr void RegexParser<Classes>::add_char_class(const ByteSet& set) {
+    // identical classes share one entry, so a token only has to carry its index
+    Token t;
+    t.kind = Token::KIND::CharClass;
+    t.class_index = classes.add(set);
+    tokens.push_back(t);
+}
+
+template <typename Classes>
+constexpr int RegexParser<Classes>::parse_repeat(std::string_view pattern, int i) {
+    // {n}, {n,}, {,m} or {n,m} starting at pattern[i], anything else is just a literal '{'
+    // returns the index of the '}' (or i if it was a literal)
+    auto literal = [&]() {
+        Token t;
+        t.ch = '{';
+        t.kind = Token::KIND::Literal;
+        tokens.push_back(t);
+        return i;
+    };
+
+    // there has to be something to repeat
+    if (tokens.empty()) return literal();
+    const Token& previous = tokens.back();
+    if (!previous.is_operand() && previous.kind != Token::KIND::RParen && !previous.is_postfix_unary()) return literal();
+
+    auto parse_number = [&](size_t& j, int& value) {
+        size_t start = j;
+        value = 0;
+        while (j < pattern.size() && pattern[j] >= '0' && pattern[j] <= '9') {
+            // clamp it, anything this big gets rejected below anyway
+            value = std::min(value * 10 + (pattern[j] - '0'), MAX_REPEAT + 1);
+            j++;
+        }
+        return j > start;
+    };
+
+    size_t j = static_cast<size_t>(i) + 1;
+    int min = 0, max = 0;
+    bool have_min = parse_number(j, min);
+    if (j < pattern.size() && pattern[j] == ',') {
+        j++;
+        if (!parse_number(j, max)) max = Token::UNBOUNDED;
+        if (!have_min && max == Token::UNBOUNDED) return literal();
+    }
+    else {
+        if (!have_min) return literal();
+        max = min;
+    }
+    if (j >= pattern.size() || pattern[j] != '}') return literal();
+
+    if (min > MAX_REPEAT || max > MAX_REPEAT) {
+        throw std::logic_error("Invalid repetition: bounds can't be bigger than " + std::to_string(MAX_REPEAT));
+    }
+    if (max != Token::UNBOUNDED && max < min) {
+        throw std::logic_error("Invalid repetition: {" + std::to_string(min) + "," + std::to_string(max) + "} has min bigger than max");
+    }
+
+    Token t;
+    t.kind = Token::KIND::Repeat;
+    t.repeat_min = min;
+    t.repeat_max = max;
+    tokens.push_back(t);
+    return static_cast<int>(j);
+}
+
+template <typename Classes>
+constexpr void RegexParser<Classes>::add_concats() {
+    // adds concats to tokens
+    // make sure we're starting fresh, the compiler can parse more than one pattern
+    concat_tokens.clear();
+    Token previous;
+    bool first = true;
+    for (Token current : tokens) {
+        if (!first && should_concat(previous, current)) {
+            Token t;
+            t.kind = Token::KIND::Concat;
+            concat_tokens.push_back(t);
+        }
+        concat_tokens.push_back(current);
+        previous = current;
+        first = false;
+    }
+};
+
+template <typename Classes>
+constexpr bool RegexParser<Classes>::should_concat(const Token& previous, const Token& current) {
+    // may want to check edge cases in future, if you expand it
+    return (previous.is_operand() || previous.kind == Token::KIND::RParen || previous.is_postfix_unary())
+    && (current.is_operand() || current.kind == Token::KIND::LParen);
+}
+
+/* --------------------- TO POSTFIX -------------------- */
+
+template <typename Classes>
+constexpr void RegexParser<Classes>::to_postfix() {
+    // gets tokens into postfix format using shunting-yard algorithm
+
+    //make sure we have a fresh postfix_tokens
+    postfix_tokens.clear();
+
+    // the operators go on a stack, which is a member so its memory gets reused from one pattern to the next
+    vector<Token>& st = operators;
+    st.clear();
+
+    for (const Token& token : concat_tokens) {
+        if (token.is_operand() || token.is_postfix_unary() || token.is_anchor()) {
+            postfix_tokens.push_back(token);
+            continue;
+        }
+        else if (token.is_operator()) {
+            while (!st.empty() && st.back().is_operator()) {
+                // all your operators are left associative. If you add in right associative operators then you'll need a check here
+                if (Token::get_precedence(st.back().kind) >= Token::get_precedence(token.kind)) {
+                    postfix_tokens.push_back(st.back());
+                    st.pop_back();
+                }
+                else break;
+            }
+            st.push_back(token);
+        }
+        else if (token.kind == Token::KIND::LParen) {
+            st.push_back(token);
+        }
+        else if (token.kind == Token::KIND::RParen) {
+            // pop everything until you reach an LParen, then swap both parens for a Group on what they held
+            while (!st.empty() && st.back().kind != Token::KIND::LParen) {
+                Token el = st.back();
+                st.pop_back();
+                postfix_tokens.push_back(el);
+            }
+            if (st.empty()) throw std::logic_error("Unbalanced parentheses: ')' without a '('");
+            Token group;
+            group.kind = Token::KIND::Group;
+            group.group = st.back().group;
+            st.pop_back();
+            postfix_tokens.push_back(group);
+        }
+        //st.push(token);
+    }
+
+    // add the remaining tokens from the stack
+    while (!st.empty()) {
+        Token t = st.back();
+        st.pop_back();
+        if (t.kind == Token::KIND::LParen) throw std::logic_error("Unbalanced parentheses: '(' without a ')'");
+        postfix_tokens.push_back(t);
+    }
+};
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+using std::vector;
+
+// Sparse set of state ids (Briggs & Torczon), used for the NFA thread lists.
+// insert, contains and clear are all O(1) and iteration is over a dense array in insertion order,
+// so unlike an unordered_set there's no hashing and nothing gets allocated once it's sized.
+class SparseSet {
+public:
+    SparseSet() = default;
+    explicit SparseSet(uint32_t capacity): dense(capacity), sparse(capacity) {}
+
+    void resize(uint32_t capacity) {
+        dense.assign(capacity, 0);
+        sparse.assign(capacity, 0);
+        count = 0;
+    }
+
+    bool contains(uint32_t value) const {
+        uint32_t index = sparse[value];
+        return index < count && dense[index] == value;
+    }
+
+    // caller makes sure value isn't already in the set
+    void insert(uint32_t value) {
+        sparse[value] = count;
+        dense[count++] = value;
+    }
+
+    void clear() { count = 0; }
+    uint32_t size() const { return count; }
+    uint32_t capacity() const { return dense.size(); }
+    bool empty() const { return count == 0; }
+
+    const uint32_t* begin() const { return dense.data(); }
+    const uint32_t* end() const { return dense.data() + count; }
+
+private:
+    vector<uint32_t> dense;
+    vector<uint32_t> sparse;
+    uint32_t count = 0;
+};
@@ -0,0 +1,408 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string_view>
+#include <vector>
+
+#include "byte_classes.h"
+#include "byte_set.h"
+#include "regex_parser.h"
+#include "token.h"
+
+using std::vector;
+
+// A pattern fixed at build time, compiled by the C++ compiler: StaticRegex<"ERROR \\d+">::is_match(line).
+// It goes through the same RegexParser as Regex does (in a constant evaluation), so a pattern means exactly the
+// same thing, and the errors Regex would throw are compile errors instead. What comes out is a DFA whose table
+// and byte classes are constexpr arrays, so there's nothing to do at startup, no heap, and matching a line is
+// one lookup per byte in read only data that the optimizer can see all of.
+//
+// It only says whether a line matches (like Matcher::is_match, with one pattern). Patterns that need more than
+// StaticCompiler::MAX_STATES dfa states don't compile, use a Regex for those.
+
+// a string literal as a template argument
+template <size_t N>
+struct FixedString {
+    char chars[N] = {};
+
+    constexpr FixedString(const char (&text)[N]) {
+        for (size_t i = 0; i < N; i++) chars[i] = text[i];
+    }
+    constexpr std::string_view view() const { return {chars, N - 1}; }
+};
+
+// the classes of a pattern parsed at compile time, there are only ever a few so they're found with a linear search
+class ClassList {
+public:
+    constexpr uint32_t add(const ByteSet& set) {
+        for (uint32_t i = 0; i < sets.size(); i++) {
+            if (sets[i] == set) return i;
+        }
+        sets.push_back(set);
+        return sets.size() - 1;
+    }
+    constexpr const ByteSet& operator[](uint32_t index) const { return sets[index]; }
+
+private:
+    vector<ByteSet> sets;
+};
+
+// Builds StaticRegex's dfa. Everything here only runs in constant evaluations, so it's free to use vectors as
+// long as none of them outlive the evaluation: the dfa gets built once to find out how big it is, and again to
+// copy it into arrays of that size.
+//
+// Rather than Thompson's construction it builds the position (Glushkov) automaton straight from the postfix tokens,
+// which has no epsilons to close over: each state of the dfa is just a set of positions. Position 0 stands for the
+// start of the pattern, and an unanchored pattern keeps it in every state, which is the restart NFA::run does.
+class StaticCompiler {
+public:
+    // a bigger table isn't worth the compile time
+    static constexpr uint32_t MAX_STATES = 4096;
+
+    // table ids are row offsets with these tags on top, like DenseDFA's
+    static constexpr uint32_t MATCH_TAG = 1u << 30;
+    static constexpr uint32_t DEAD_TAG = 1u << 29;
+    static constexpr uint32_t END_MATCH_TAG = 1u << 28;
+    static constexpr uint32_t ID_MASK = END_MATCH_TAG - 1;
+
+    struct Shape {
+        uint32_t states = 0;
+        uint32_t stride = 0;
+    };
+
+    template <size_t TableSize>
+    struct Tables {
+        std::array<uint32_t, TableSize> table{};
+        std::array<uint8_t, 256> classes{};
+        uint32_t start = 0;
+    };
+
+    static constexpr Shape shape(std::string_view pattern) {
+        DFA dfa = build(pattern);
+        return {static_cast<uint32_t>(dfa.table.size() / dfa.stride), dfa.stride};
+    }
+
+    template <size_t TableSize>
+    static constexpr Tables<TableSize> tables(std::string_view pattern) {
+        DFA dfa = build(pattern);
+        Tables<TableSize> result;
+        for (size_t i = 0; i < TableSize; i++) result.table[i] = dfa.table[i];
+        result.classes = dfa.classes.map();
+        result.start = dfa.start;
+        return result;
+    }
+
+private:
+    // a set of positions, one bit each
+    using Bits = vector<uint64_t>;
+
+    // what the postfix evaluation knows about a sub-expression: where it can start and end, and if it can be empty
+    // (its positions are the ones from lo up, every operand's positions come right after the ones before it)
+    struct Fragment {
+        uint32_t lo = 0;
+        vector<uint32_t> first;
+        vector<uint32_t> last;
+        bool nullable = false;
+    };
+
+    struct Positions {
+        // what each position matches, position 0 (the start) matches nothing
+        vector<ByteSet> sets = {ByteSet{}};
+        // where each position can go next
+        vector<vector<uint32_t>> follow = {{}};
+
+        constexpr uint32_t add(const ByteSet& set) {
+            sets.push_back(set);
+            follow.emplace_back();
+            return sets.size() - 1;
+        }
+    };
+
+    struct Automaton {
+        Positions positions;
+        vector<uint32_t> last;
+        bool nullable = false;
+        bool start_anchor = false;
+        bool end_anchor = false;
+    };
+
+    struct DFA {
+        vector<uint32_t> table;
+        ByteClasses classes;
+        uint32_t stride = 0;
+        uint32_t start = 0;
+    };
+
+    static constexpr void append(vector<uint32_t>& to, const vector<uint32_t>& from) {
+        to.insert(to.end(), from.begin(), from.end());
+    }
+
+    static constexpr void link(Positions& positions, const vector<uint32_t>& from, const vector<uint32_t>& to) {
+        for (uint32_t p : from) append(positions.follow[p], to);
+    }
+
+    static constexpr Fragment concat(Positions& positions, Fragment a, const Fragment& b) {
+        link(positions, a.last, b.first);
+        if (a.nullable) append(a.first, b.first);
+        vector<uint32_t> last = b.last;
+        if (b.nullable) append(last, a.last);
+        a.last = last;
+        a.nullable = a.nullable && b.nullable;
+        return a;
+    }
+
+    static constexpr Fragment optional(Fragment a) {
+        a.nullable = true;
+        return a;
+    }
+
+    static constexpr Fragment loop(Positions& positions, Fragment a) {
+        link(positions, a.last, a.first);
+        return a;
+    }
+
+    // a fresh copy of a, whose positions are the ones from a.lo up to end, for {n,m}
+    static constexpr Fragment copy(Positions& positions, const Fragment& a, uint32_t end) {
+        const uint32_t offset = positions.sets.size() - a.lo;
+        for (uint32_t p = a.lo; p < end; p++) {
+            uint32_t q = positions.add(positions.sets[p]);
+            for (uint32_t next : positions.follow[p]) positions.follow[q].push_back(next + offset);
+        }
+        Fragment result = a;
+        result.lo += offset;
+        for (uint32_t& p : result.first) p += offset;
+        for (uint32_t& p : result.last) p += offset;
+        return result;
+    }
+
+    // the same shape RegexCompiler::repeat_fragment builds: n copies of a, then m - n nested optional ones
+    static constexpr Fragment repeat(Positions& positions, const Fragment& a, int min, int max) {
+        int copies = std::max(min, max == Token::UNBOUNDED ? 1 : max);
+        if (copies > RegexParser<ClassList>::MAX_REPEAT) throw std::logic_error("Invalid repetition: too many copies");
+        // the copies are of a as it is now, so make them all before wiring any of them up
+        const uint32_t end = positions.sets.size();
+        vector<Fragment> parts = {a};
+        for (int i = 1; i < copies; i++) parts.push_back(copy(positions, a, end));
+
+        if (copies == 0) return {static_cast<uint32_t>(positions.sets.size()), {}, {}, true};
+
+        // from the back: {n,} loops the last copy, {n,m} nests the optional ones inside each other
+        Fragment result = parts.back();
+        if (max == Token::UNBOUNDED) {
+            result = loop(positions, result);
+            if (min == 0) result = optional(result);
+        }
+        else if (copies > min) result = optional(result);
+        for (int i = copies - 2; i >= 0; i--) {
+            result = concat(positions, parts[i], result);
+            if (i >= min) result = optional(result);
+        }
+        return result;
+    }
+
+    // the position automaton of the postfix tokens, checked the same way RegexCompiler::add_pattern checks them
+    static constexpr Automaton positions_of(std::string_view pattern) {
+        RegexParser<ClassList> parser;
+        const vector<Token> tokens = parser.parse(pattern);
+
+        Automaton automaton;
+        Positions& positions = automaton.positions;
+        vector<Fragment> fragments;
+        auto pop = [&](size_t needed, const char* error) {
+            if (fragments.size() < needed) throw std::logic_error(error);
+            Fragment top = fragments.back();
+            fragments.pop_back();
+            return top;
+        };
+
+        for (const Token& token : tokens) {
+            switch (token.kind) {
+                case Token::KIND::Literal:
+                case Token::KIND::CharClass: {
+                    ByteSet set;
+                    if (token.kind == Token::KIND::Literal) set.insert(token.ch);
+                    else set = parser.char_class(token.class_index);
+                    uint32_t p = positions.add(set);
+                    fragments.push_back({p, {p}, {p}, false});
+                    break;
+                }
+                case Token::KIND::Concat: {
+                    Fragment b = pop(2, "Malformed postfix expression: concat needs 2 operands");
+                    Fragment a = pop(1, "Malformed postfix expression: concat needs 2 operands");
+                    fragments.push_back(concat(positions, a, b));
+                    break;
+                }
+                case Token::KIND::Alt: {
+                    Fragment b = pop(2, "Malformed postfix expression: alt needs 2 operands");
+                    Fragment a = pop(1, "Malformed postfix expression: alt needs 2 operands");
+                    append(a.first, b.first);
+                    append(a.last, b.last);
+                    a.nullable = a.nullable || b.nullable;
+                    fragments.push_back(a);
+                    break;
+                }
+                case Token::KIND::Star:
+                    fragments.push_back(optional(loop(positions, pop(1, "Malformed postfix expression: star needs an operand"))));
+                    break;
+                case Token::KIND::Plus:
+                    fragments.push_back(loop(positions, pop(1, "Malformed postfix expression: plus needs an operand")));
+                    break;
+                case Token::KIND::Question:
+                    fragments.push_back(optional(pop(1, "Malformed postfix expression: question needs an operand")));
+                    break;
+                case Token::KIND::Group:
+                    // a group only matters for captures, which a StaticRegex doesn't do
+                    fragments.push_back(pop(1, "Malformed postfix expression: group needs an operand"));
+                    break;
+                case Token::KIND::Repeat: {
+                    Fragment a = pop(1, "Malformed postfix expression: repeat needs an operand");
+                    fragments.push_back(repeat(positions, a, token.repeat_min, token.repeat_max));
+                    break;
+                }
+                case Token::KIND::StartAnchor:
+                    automaton.start_anchor = true;
+                    break;
+                case Token::KIND::EndAnchor:
+                    automaton.end_anchor = true;
+                    break;
+                default:
+                    break;
+            }
+        }
+        if (fragments.size() != 1) throw std::logic_error("Malformed NFA: no final fragment for start and accept states");
+
+        const Fragment& pattern_fragment = fragments.back();
+        append(positions.follow[0], pattern_fragment.first);
+        automaton.last = pattern_fragment.last;
+        automaton.nullable = pattern_fragment.nullable;
+        return automaton;
+    }
+
+    static constexpr uint64_t hash(const Bits& bits) {
+        uint64_t h = 0xcbf29ce484222325ull;
+        for (uint64_t word : bits) h = (h ^ word) * 0x100000001b3ull;
+        return h;
+    }
+
+    static constexpr DFA build(std::string_view pattern) {
+        const Automaton automaton = positions_of(pattern);
+        const Positions& positions = automaton.positions;
+        const uint32_t count = positions.sets.size();
+        const uint32_t words = (count + 63) / 64;
+        auto bit = [](const Bits& bits, uint32_t p) { return ((bits[p / 64] >> (p % 64)) & 1) != 0; };
+        auto set_bit = [](Bits& bits, uint32_t p) { bits[p / 64] |= uint64_t(1) << (p % 64); };
+
+        DFA dfa;
+        for (uint32_t p = 1; p < count; p++) {
+            const ByteSet& set = positions.sets[p];
+            dfa.classes.refine([&](unsigned char ch) { return set.contains(ch); });
+        }
+        dfa.stride = dfa.classes.size();
+
+        // the positions each class takes, and where each position goes, as bitsets
+        vector<Bits> takes(dfa.stride, Bits(words, 0));
+        for (uint32_t k = 0; k < dfa.stride; k++) {
+            const unsigned char ch = dfa.classes.representative(k);
+            for (uint32_t p = 1; p < count; p++) {
+                if (positions.sets[p].contains(ch)) set_bit(takes[k], p);
+            }
+        }
+        vector<Bits> follow(count, Bits(words, 0));
+        for (uint32_t p = 0; p < count; p++) {
+            for (uint32_t q : positions.follow[p]) set_bit(follow[p], q);
+        }
+        Bits last(words, 0);
+        for (uint32_t p : automaton.last) set_bit(last, p);
+
+        // the dfa states, and an open addressing table of their indexes (+ 1, 0 is empty) to find them again
+        vector<Bits> states;
+        vector<uint32_t> buckets(64, 0);
+        auto tagged_id = [&](uint32_t index) {
+            const Bits& state = states[index];
+            bool match = automaton.nullable && bit(state, 0);
+            bool empty = true;
+            for (uint32_t w = 0; w < words; w++) {
+                if (state[w] & last[w]) match = true;
+                if (state[w]) empty = false;
+            }
+            uint32_t id = index * dfa.stride;
+            if (match) id |= automaton.end_anchor ? END_MATCH_TAG : MATCH_TAG | END_MATCH_TAG;
+            if (empty) id |= DEAD_TAG;
+            return id;
+        };
+        auto find_or_add = [&](const Bits& state) {
+            if (states.size() * 2 >= buckets.size()) {
+                vector<uint32_t> bigger(buckets.size() * 2, 0);
+                for (uint32_t i = 0; i < states.size(); i++) {
+                    size_t slot = hash(states[i]) & (bigger.size() - 1);
+                    while (bigger[slot] != 0) slot = (slot + 1) & (bigger.size() - 1);
+                    bigger[slot] = i + 1;
+                }
+                buckets = bigger;
+            }
+            size_t slot = hash(state) & (buckets.size() - 1);
+            while (buckets[slot] != 0) {
+                if (states[buckets[slot] - 1] == state) return buckets[slot] - 1;
+                slot = (slot + 1) & (buckets.size() - 1);
+            }
+            if (states.size() >= MAX_STATES) throw std::logic_error("pattern needs too many dfa states for a StaticRegex");
+            states.push_back(state);
+            buckets[slot] = states.size();
+            return static_cast<uint32_t>(states.size() - 1);
+        };
+
+        Bits start(words, 0);
+        set_bit(start, 0);
+        find_or_add(start);
+        // the subset construction, one new state at a time, filling in its row as we go
+        for (uint32_t index = 0; index < states.size(); index++) {
+            Bits reachable(words, 0);
+            for (uint32_t p = 0; p < count; p++) {
+                if (!bit(states[index], p)) continue;
+                for (uint32_t w = 0; w < words; w++) reachable[w] |= follow[p][w];
+            }
+            for (uint32_t k = 0; k < dfa.stride; k++) {
+                Bits next(words, 0);
+                for (uint32_t w = 0; w < words; w++) next[w] = reachable[w] & takes[k][w];
+                if (!automaton.start_anchor) set_bit(next, 0);
+                uint32_t target = find_or_add(next);
+                // states is what we're iterating over, so the row goes in once we know every target
+                dfa.table.push_back(target);
+            }
+        }
+        for (uint32_t& target : dfa.table) target = tagged_id(target);
+        dfa.start = tagged_id(0);
+        return dfa;
+    }
+};
+
+template <FixedString Pattern>
+class StaticRegex {
+public:
+    // does the pattern match somewhere in line, the same answer Matcher::is_match gives for it
+    static constexpr bool is_match(std::string_view line) {
+        uint32_t current = dfa.start;
+        if (current & StaticCompiler::MATCH_TAG) return true;
+        if (current & StaticCompiler::DEAD_TAG) return false;
+        for (const char c : line) {
+            current = dfa.table[(current & StaticCompiler::ID_MASK) + dfa.classes[static_cast<unsigned char>(c)]];
+            if (current >= StaticCompiler::DEAD_TAG) return (current & StaticCompiler::MATCH_TAG) != 0;
+        }
+        return (current & StaticCompiler::END_MATCH_TAG) != 0;
+    }
+
+    static constexpr std::string_view pattern() { return Pattern.view(); }
+    static constexpr uint32_t state_count() { return shape.states; }
+
+private:
+    static constexpr StaticCompiler::Shape shape = StaticCompiler::shape(Pattern.view());
+    static constexpr auto dfa = StaticCompiler::tables<size_t{shape.states} * shape.stride>(Pattern.view());
+};
+
+// the spelling the standard library would use
+template <FixedString Pattern>
+using static_regex = StaticRegex<Pattern>;
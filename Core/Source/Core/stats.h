@@ -0,0 +1,61 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+
+// What compiling the patterns cost and what came out of it, filled in by Regex (see Regex::get_compile_stats).
+// It's a handful of clock reads per Regex, so it's always there.
+struct CompileStats {
+    // tokenizing and the shunting yard, then building the automata (nfa, reverse nfa, prefilter and the rest)
+    double parse_seconds = 0;
+    double compile_seconds = 0;
+    uint32_t patterns = 0;
+    uint32_t nfa_states = 0;
+    // 0 unless the Regex was built with spans
+    uint32_t reverse_nfa_states = 0;
+    // columns in a dfa table row
+    uint32_t byte_classes = 0;
+};
+
+// What a Matcher did, from Matcher::stats once collect_stats has turned the line counts on.
+// The engine counters (dfa cache, nfa threads) are counted either way, they only change off the hot path.
+struct MatchStats {
+    // what checked the lines (Matcher::engine_name)
+    const char* engine = nullptr;
+    // bytes handed to the matcher
+    uint64_t bytes_scanned = 0;
+    // lines the prefilter (or aho-corasick) stepped over without anything looking at them
+    uint64_t lines_skipped = 0;
+    uint64_t bytes_skipped = 0;
+    // lines that got as far as being checked, and how many of those matched
+    uint64_t lines_tested = 0;
+    uint64_t lines_matched = 0;
+
+    // bytes the lazy dfas stepped over a cached transition, and transitions they had to work out
+    uint64_t dfa_cache_hits = 0;
+    uint64_t dfa_cache_misses = 0;
+    uint64_t dfa_flushes = 0;
+    // the most states a dfa had cached at once
+    uint64_t dfa_peak_states = 0;
+    // dfas that gave up on their cache and went back to the nfa
+    uint64_t dfa_fallbacks = 0;
+    // the most states NFA::run had active at once
+    uint64_t nfa_peak_threads = 0;
+
+    // combine the stats of several matchers (one per thread): counts add up, peaks take the biggest
+    MatchStats& operator+=(const MatchStats& other) {
+        if (!engine) engine = other.engine;
+        bytes_scanned += other.bytes_scanned;
+        lines_skipped += other.lines_skipped;
+        bytes_skipped += other.bytes_skipped;
+        lines_tested += other.lines_tested;
+        lines_matched += other.lines_matched;
+        dfa_cache_hits += other.dfa_cache_hits;
+        dfa_cache_misses += other.dfa_cache_misses;
+        dfa_flushes += other.dfa_flushes;
+        dfa_peak_states = std::max(dfa_peak_states, other.dfa_peak_states);
+        dfa_fallbacks += other.dfa_fallbacks;
+        nfa_peak_threads = std::max(nfa_peak_threads, other.nfa_peak_threads);
+        return *this;
+    }
+};
@@ -0,0 +1,51 @@
+#include "stream_matcher.h"
+
+StreamMatcher::StreamMatcher(const Regex& regex, LazyDFAConfig config):
+    prefilter(regex.get_prefilter()), literals(regex.get_literals()), dense_dfa(regex.get_dense_dfa()), dfa(regex.get_nfa(), config) {
+    start_line();
+}
+
+void StreamMatcher::reset() {
+    fed = 0;
+    line_start = 0;
+    start_line();
+}
+
+void StreamMatcher::start_line() {
+    decided = false;
+    literal_state = 0;
+    if (literals) return;
+    if (dense_dfa) dense_state = dense_dfa->line_start();
+    else dfa.start_line();
+}
+
+bool StreamMatcher::resume(std::string_view piece) {
+    if (literals) return literals->resume(literal_state, piece);
+    if (dense_dfa) return dense_dfa->resume(dense_state, piece);
+    return dfa.resume(piece);
+}
+
+bool StreamMatcher::end_line() const {
+    // aho-corasick only stops early when it's found a literal, and there's no other way for a line to match
+    if (literals) return decided;
+    if (dense_dfa) return DenseDFA::end_line(dense_state);
+    return dfa.end_line();
+}
+
+MatchStats StreamMatcher::stats() const {
+    MatchStats total = counts;
+    total.engine = engine_name();
+    total.dfa_cache_hits = dfa.cache_hits();
+    total.dfa_cache_misses = dfa.cache_misses();
+    total.dfa_flushes = dfa.flush_count();
+    total.dfa_peak_states = dfa.peak_cached_states();
+    total.dfa_fallbacks = dfa.using_nfa();
+    total.nfa_peak_threads = dfa.peak_nfa_threads();
+    return total;
+}
+
+const char* StreamMatcher::engine_name() const {
+    if (literals) return "aho-corasick";
+    if (dense_dfa) return "dense dfa";
+    return "lazy dfa";
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+#include "aho_corasick.h"
+#include "dense_dfa.h"
+#include "lazy_dfa.h"
+#include "prefilter.h"
+#include "regex.h"
+#include "stats.h"
+
+// A line StreamMatcher found a match in. start and end are offsets from the start of the stream (the '\n' isn't
+// part of the line), and text is the part of it that was in the chunk that finished it: all of it, unless it
+// started in an earlier chunk (complete() says which). A caller that wants every line whole keeps the unfinished
+// end of each chunk until the next one, which is never more than one line.
+struct LineMatch {
+    uint64_t start = 0;
+    uint64_t end = 0;
+    std::string_view text;
+
+    bool complete() const { return text.size() == end - start; }
+};
+
+// Line matcher for input that comes in chunks cut anywhere (off a socket, or from a file that's still being
+// written), without putting the lines back together first. The automaton's state is kept from one chunk to the
+// next, so every byte gets looked at once, nothing is copied, and a line is reported as soon as its '\n' comes in.
+// A set of literals goes to aho-corasick, a saved dfa is used as it is, and everything else gets a lazy dfa.
+// The prefilter skips the whole lines in a chunk without its literal, like it does for Matcher, but the
+// unfinished line at the end of a chunk always goes through the automaton, since the literal could be cut in half.
+// Like Matcher, it holds working memory, so keep one per stream.
+class StreamMatcher {
+public:
+    explicit StreamMatcher(const Regex& regex, LazyDFAConfig config = {});
+    ~StreamMatcher() = default;
+
+    // the next size bytes of the stream: calls on_match(const LineMatch&) for every matching line that ends in them
+    template <typename OnMatch>
+    void feed(const char* data, size_t size, OnMatch&& on_match);
+    // the stream is over, so a last line without a '\n' is finished too (its text is empty, it all came in
+    // earlier chunks). after this it's ready for a new stream
+    template <typename OnMatch>
+    void finish(OnMatch&& on_match);
+    // drop the line in progress and start again at offset 0 (for a file that got truncated)
+    void reset();
+
+    // bytes fed since the stream started
+    uint64_t offset() const { return fed; }
+    // where the line we're in the middle of started, so fed - line_offset bytes of it have gone by
+    uint64_t line_offset() const { return line_start; }
+
+    // bytes fed and skipped by the prefilter, lines the automaton finished and how many of them matched, with the
+    // lazy dfa's counters (lines_skipped isn't counted, that would mean looking for the '\n's the prefilter skips)
+    MatchStats stats() const;
+    const char* engine_name() const;
+
+private:
+    const Prefilter& prefilter;
+    const AhoCorasick* literals;
+    const DenseDFA* dense_dfa;
+    LazyDFA dfa;
+    // where aho-corasick or the saved dfa have got to in the current line (the lazy dfa keeps its own)
+    uint32_t literal_state = 0;
+    uint32_t dense_state = 0;
+    // the part of the line we've seen already decides it, so the rest of it just gets skipped
+    bool decided = false;
+    uint64_t fed = 0;
+    uint64_t line_start = 0;
+    MatchStats counts;
+
+    void start_line();
+    bool resume(std::string_view piece);
+    bool end_line() const;
+};
+
+template <typename OnMatch>
+void StreamMatcher::feed(const char* data, size_t size, OnMatch&& on_match) {
+    const char* const end = data + size;
+    const char* piece = data;
+    // one piece per line, or the part of one that's in this chunk
+    while (piece != end) {
+        // at the start of a line that's all in this chunk, skip to the line the prefilter's literal is in
+        // (or past every whole line, if it isn't anywhere)
+        if (!literals && !prefilter.empty() && fed + (piece - data) == line_start) {
+            std::string_view rest(piece, end - piece);
+            size_t hit = prefilter.find(rest);
+            // rfind gives npos when there's no '\n' before, and npos + 1 is 0: nothing to skip
+            size_t skip = hit == std::string_view::npos ? rest.rfind('\n') + 1 : hit == 0 ? 0 : rest.rfind('\n', hit - 1) + 1;
+            counts.bytes_skipped += skip;
+            line_start += skip;
+            piece += skip;
+            if (piece == end) break;
+        }
+
+        const char* newline = static_cast<const char*>(std::memchr(piece, '\n', end - piece));
+        const char* piece_end = newline ? newline : end;
+        if (!decided) decided = resume(std::string_view(piece, piece_end - piece));
+        if (!newline) break;
+
+        uint64_t line_end = fed + (newline - data);
+        counts.lines_tested++;
+        if (end_line()) {
+            counts.lines_matched++;
+            const char* text = line_start >= fed ? data + (line_start - fed) : data;
+            on_match(LineMatch{ line_start, line_end, std::string_view(text, newline - text) });
+        }
+        line_start = line_end + 1;
+        start_line();
+        piece = newline + 1;
+    }
+    fed += size;
+    counts.bytes_scanned += size;
+}
+
+template <typename OnMatch>
+void StreamMatcher::finish(OnMatch&& on_match) {
+    if (fed > line_start) {
+        counts.lines_tested++;
+        if (end_line()) {
+            counts.lines_matched++;
+            on_match(LineMatch{ line_start, fed, std::string_view() });
+        }
+    }
+    reset();
+}
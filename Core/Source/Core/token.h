@@ -1,37 +1,44 @@
 #pragma once
 
-#include <array>
-
-using std::array;
+#include <cstdint>
 
 // Token is a POD-like type (Plain Old Data)
+// it's kept small (a character class is an index into the compiler's classes rather than its own bitmap)
+// because every pattern's tokens get copied through several passes of the compiler
 struct Token {
     // kind of token will be set via an enum for all possible tokens
-    enum class KIND { Literal, CharClass, Star, Plus, Question, Concat, Alt, LParen, RParen, StartAnchor, EndAnchor};
+    // Group only comes out of to_postfix, where a pair of parens becomes a unary operator on what was between them
+    enum class KIND : uint8_t { Literal, CharClass, Star, Plus, Question, Repeat, Concat, Alt, LParen, RParen, Group, StartAnchor, EndAnchor};
+    // repeat_max for {n,}
+    static constexpr int UNBOUNDED = -1;
     // set default to the literal character
     KIND kind = KIND::Literal;
 
     // payloads (some kinds need data, so this is where you store it)
     char ch = 0; // ch value for literals
-    bool negate = false; // differentiates [abc] or [^abc]
-    std::array<bool, 256> bitmap{}; // stores bitmap for character classes, for 256 ascii chars
+    uint32_t class_index = 0; // which of the compiler's classes (RegexCompiler::char_class) a CharClass matches
+    int repeat_min = 0; // bounds for {n,m}
+    int repeat_max = 0;
+    int group = 0; // capture group number for LParen and Group, counting '('s from 1
 
-    bool is_postfix_unary() const {
+    constexpr bool is_postfix_unary() const {
         switch (kind) {
             case KIND::Star:
             case KIND::Plus:
             case KIND::Question:
+            case KIND::Repeat:
                 return true;
             default:
                 return false;
         }
     };
 
-    bool is_operator() const {
+    constexpr bool is_operator() const {
         switch (kind) {
             case KIND::Star:
             case KIND::Plus:
             case KIND::Question:
+            case KIND::Repeat:
             case KIND::Concat:
             case KIND::Alt:
                 return true;
@@ -40,7 +47,7 @@ struct Token {
         }
     };
 
-    bool is_operand() const {
+    constexpr bool is_operand() const {
         switch(kind) {
             case KIND::Literal:
             case KIND::CharClass:
@@ -50,7 +57,7 @@ struct Token {
         }
     };
 
-	bool is_anchor() const {
+	constexpr bool is_anchor() const {
 		switch(kind) {
 			case KIND::StartAnchor:
 			case KIND::EndAnchor:
@@ -65,6 +72,7 @@ struct Token {
             case KIND::Star:
             case KIND::Plus:
             case KIND::Question:
+            case KIND::Repeat:
                 return 3;
             case KIND::Concat:
                 return 2;
@@ -74,27 +82,4 @@ struct Token {
                 return 0;
         }
     };
-
-    void set_neg_char_class() {
-        negate = true;
-        bitmap.fill(true);
-    }
-
-    void add_to_char_class(unsigned char ascii) {
-        // takes an ascii and adds it to the bitmap
-        if (!negate) {bitmap[ascii] = true;}
-        else {bitmap[ascii] = false;}
-
-    };
-
-    void add_range_to_char_class(unsigned char start, unsigned char end) {
-        for (unsigned char ch = start; ch <= end; ch++) {
-            add_to_char_class(ch);
-		if (ch == end) break;
-        }
-    };
-
-    void clear_bitmap() {
-        bitmap.fill(false);
-    }
 };
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <string_view>
+
+// No framework: a check that fails is printed to stderr and counted, and main exits with 1 if any did.
+
+void check(bool ok, std::string_view what);
+
+// Every file of tests adds its checks with one of these at namespace scope, and main runs them all:
+//     const TestGroup group("prefilter", prefilter_tests);
+struct TestGroup {
+    TestGroup(const char* name, void (*run)());
+};
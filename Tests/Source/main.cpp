@@ -0,0 +1,47 @@
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "check.h"
+
+// Checks that Core gives the same answers whichever way it gets to them. Run it with no arguments; it prints
+// the checks that failed and exits with 1 if there were any.
+
+namespace {
+    struct Group {
+        const char* name;
+        void (*run)();
+    };
+
+    // a function so it's there before the first TestGroup adds itself, whichever file that's in
+    std::vector<Group>& groups() {
+        static std::vector<Group> all;
+        return all;
+    }
+
+    int failures = 0;
+    int checks = 0;
+}
+
+TestGroup::TestGroup(const char* name, void (*run)()) {
+    groups().push_back({ name, run });
+}
+
+void check(bool ok, std::string_view what) {
+    checks++;
+    if (ok) return;
+    failures++;
+    std::cerr << "FAILED: " << what << std::endl;
+}
+
+int main() {
+    for (const Group& group : groups()) {
+        int failed_before = failures;
+        int checked_before = checks;
+        group.run();
+        std::cerr << group.name << ": " << (checks - checked_before) - (failures - failed_before) << "/" << checks - checked_before << std::endl;
+    }
+
+    std::cerr << checks - failures << "/" << checks << " checks passed" << std::endl;
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,60 @@
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "../../Core/Source/Core/matcher.h"
+#include "../../Core/Source/Core/regex.h"
+#include "check.h"
+
+using std::string;
+
+namespace {
+    // a literal that doesn't repeat itself, so only the whole thing can match it
+    string literal(size_t length, char first) {
+        string text;
+        for (size_t i = 0; i < length; i++) text += static_cast<char>(first + i % 26);
+        return text;
+    }
+
+    // the line on its own and as part of a buffer, since for_each_match takes the prefilter's shortcut
+    // through a whole buffer and is_match doesn't
+    void check_line(const Regex& regex, const string& pattern, const string& line, bool expected) {
+        Matcher matcher(regex);
+        string what = "/" + pattern + "/ on \"" + line + "\"";
+        check(matcher.is_match(line) == expected, "is_match " + what);
+
+        int matched = 0;
+        matcher.for_each_match("nothing here\n" + line + "\nor here", [&](std::string_view) { matched++; });
+        check(matched == (expected ? 1 : 0), "for_each_match " + what);
+    }
+
+    void prefilter_tests() {
+        // a repeated literal longer than the prefilter keeps gets cut short, and then it isn't the whole pattern
+        // any more: finding it mustn't count as a match, and the literal after it mustn't get tacked on to the cut
+        for (const auto& [piece, copies] : { std::pair{ literal(72, 'a'), 1 }, std::pair{ literal(40, 'A'), 2 } }) {
+            string repeated;
+            for (int i = 0; i < copies; i++) repeated += piece;
+            string pattern = "(" + piece + "){" + std::to_string(copies) + "}";
+
+            Regex regex({ pattern });
+            check(!regex.get_prefilter().is_exact(), "prefilter for /" + pattern + "/ isn't exact");
+            check_line(regex, pattern, repeated, true);
+            check_line(regex, pattern, "xx" + repeated + "yy", true);
+            check_line(regex, pattern, repeated.substr(0, 64) + "QQQ", false);
+            check_line(regex, pattern, repeated.substr(0, repeated.size() - 1), false);
+
+            Regex followed({ pattern + "Z" });
+            check_line(followed, pattern + "Z", "xx" + repeated + "Z", true);
+            check_line(followed, pattern + "Z", repeated.substr(0, 64) + "Z", false);
+            check_line(followed, pattern + "Z", repeated, false);
+        }
+
+        // short enough to keep whole, so it's still exact
+        Regex whole({ "(abc){3}" });
+        check(whole.get_prefilter().is_exact(), "prefilter for /(abc){3}/ is exact");
+        check_line(whole, "(abc){3}", "xabcabcabcx", true);
+        check_line(whole, "(abc){3}", "abcabcab", false);
+    }
+}
+
+const TestGroup prefilter_group("prefilter", prefilter_tests);
@@ -0,0 +1,93 @@
+#include <random>
+#include <string>
+#include <string_view>
+
+#include "../../Core/Source/Core/matcher.h"
+#include "../../Core/Source/Core/regex.h"
+#include "../../Core/Source/Core/static_regex.h"
+#include "check.h"
+
+using std::string;
+
+// these are worked out by the compiler, so a wrong answer here fails the build rather than the run
+static_assert(StaticRegex<"a+b">::is_match("xxaab"));
+static_assert(!StaticRegex<"a+b">::is_match("xxaa"));
+static_assert(StaticRegex<"^ab$">::is_match("ab"));
+static_assert(!StaticRegex<"^ab$">::is_match("cab"));
+static_assert(StaticRegex<"[^abc]x">::is_match("ax dx"));
+static_assert(!StaticRegex<"[^abc]x">::is_match("ax bx"));
+static_assert(StaticRegex<"(ab){2,3}$">::is_match("xabab"));
+static_assert(!StaticRegex<"^(ab){2,3}$">::is_match("abababab"));
+static_assert(StaticRegex<"cat|dog">::is_match("hotdog"));
+static_assert(static_regex<"ERROR \\d+">::is_match("x ERROR 42"));
+
+namespace {
+    // random lines over a small alphabet, so the patterns below match some of them and not others
+    string random_line(std::mt19937& rng) {
+        const char alphabet[] = "abc1X _0\t.";
+        string line;
+        for (unsigned i = rng() % 12; i > 0; i--) line += alphabet[rng() % (sizeof(alphabet) - 1)];
+        return line;
+    }
+
+    // StaticRegex and Matcher have separate compilers, so they should only agree if both got it right
+    template <FixedString Pattern>
+    void check_same() {
+        string pattern(Pattern.view());
+        Regex regex({ pattern });
+        Matcher matcher(regex);
+        // the same lines for every pattern, every run
+        std::mt19937 rng(7);
+        int mismatches = 0;
+        string first;
+        for (int i = 0; i < 2000; i++) {
+            string line = random_line(rng);
+            if (matcher.is_match(line) == StaticRegex<Pattern>::is_match(line)) continue;
+            if (mismatches++ == 0) first = line;
+        }
+        check(mismatches == 0, "StaticRegex and Matcher agree on /" + pattern + "/ (first difference on \"" + first + "\")");
+    }
+
+    void static_regex_tests() {
+        // literals and alternation
+        check_same<"a">();
+        check_same<"ab">();
+        check_same<"a|b">();
+        check_same<"(ab|a)b?">();
+        check_same<"(a|b)*a(a|b)(a|b)">();
+        check_same<"\\.\\[">();
+        // loops
+        check_same<"a*">();
+        check_same<"(a|b)*c">();
+        check_same<"a+b+">();
+        check_same<"(a*)*">();
+        check_same<"(a?b?)+x">();
+        // classes
+        check_same<"[abc]+">();
+        check_same<"[^abc]">();
+        check_same<"[abc1]X">();
+        check_same<"\\d\\w\\s">();
+        check_same<"\\d+">();
+        check_same<"a.b">();
+        check_same<".">();
+        // anchors
+        check_same<"^a">();
+        check_same<"a$">();
+        check_same<"^a*$">();
+        check_same<"^(ab|a)b?$">();
+        check_same<"[^a]+$">();
+        check_same<"^(\\d|x)+ $">();
+        // counted repetition
+        check_same<"a{2}">();
+        check_same<"a{2,}">();
+        check_same<"a{,2}b">();
+        check_same<"a{0}b">();
+        check_same<"a{0,0}">();
+        check_same<"(ab){1,3}$">();
+        check_same<"(a|b{2,3}){2}c">();
+        check_same<"[ab]{3,5}$">();
+        check_same<"0{,3}1{1}">();
+    }
+}
+
+const TestGroup static_regex_group("static regex", static_regex_tests);
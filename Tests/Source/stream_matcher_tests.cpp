@@ -0,0 +1,102 @@
+#include <cstdint>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "../../Core/Source/Core/matcher.h"
+#include "../../Core/Source/Core/regex.h"
+#include "../../Core/Source/Core/stream_matcher.h"
+#include "check.h"
+
+using std::string, std::vector;
+
+namespace {
+    // lines the prefilter skips, a literal that a split can land in the middle of, an empty line,
+    // and a last line without a '\n'
+    const string INPUT =
+        "ERROR 42 first\n"
+        "nothing to see\n"
+        "\n"
+        "an ERROR without digits\n"
+        "xx ERROR 7\n"
+        "foo and bar baz\n"
+        "qux\n"
+        "too big\n"
+        "ERR\n"
+        "last ERROR 9 without a newline, foo to";
+
+    struct Found {
+        uint64_t start;
+        uint64_t end;
+        bool operator==(const Found&) const = default;
+    };
+
+    // what Matcher says about every line of the input, as (start, end) offsets
+    vector<Found> expected_lines(const Regex& regex) {
+        Matcher matcher(regex);
+        vector<Found> found;
+        size_t start = 0;
+        while (start < INPUT.size()) {
+            size_t end = INPUT.find('\n', start);
+            if (end == string::npos) end = INPUT.size();
+            if (matcher.is_match(std::string_view(INPUT).substr(start, end - start))) found.push_back({ start, end });
+            start = end + 1;
+        }
+        return found;
+    }
+
+    // feed the input in the pieces cut at cuts, and check the lines it reports against Matcher's
+    void check_chunks(StreamMatcher& stream, const vector<Found>& expected, const vector<size_t>& cuts, const string& what) {
+        vector<Found> found;
+        bool text_right = true;
+        auto on_match = [&](const LineMatch& match) {
+            found.push_back({ match.start, match.end });
+            std::string_view line = std::string_view(INPUT).substr(match.start, match.end - match.start);
+            // a line that started in an earlier chunk only has the end of it
+            if (match.complete()) text_right = text_right && match.text == line;
+            else text_right = text_right && match.text.size() < line.size() && line.ends_with(match.text);
+        };
+
+        size_t from = 0;
+        for (size_t cut : cuts) {
+            stream.feed(INPUT.data() + from, cut - from, on_match);
+            from = cut;
+        }
+        stream.feed(INPUT.data() + from, INPUT.size() - from, on_match);
+        check(stream.offset() == INPUT.size(), what + ": offset is the whole input");
+        stream.finish(on_match);
+
+        check(found == expected, what + ": same lines as Matcher");
+        check(text_right, what + ": text is the line (or the end of it)");
+    }
+
+    // split in two at every offset, then in random pieces of 1 to 7 bytes
+    void check_stream(const Regex& regex, std::string_view engine, const string& what) {
+        StreamMatcher stream(regex);
+        check(stream.engine_name() == engine, what + " uses the " + string(engine));
+        vector<Found> expected = expected_lines(regex);
+
+        for (size_t cut = 0; cut <= INPUT.size(); cut++) {
+            check_chunks(stream, expected, { cut }, what + " split at " + std::to_string(cut));
+        }
+
+        std::mt19937 rng(11);
+        for (int round = 0; round < 50; round++) {
+            vector<size_t> cuts;
+            for (size_t at = 1 + rng() % 7; at < INPUT.size(); at += 1 + rng() % 7) cuts.push_back(at);
+            check_chunks(stream, expected, cuts, what + " in random pieces, round " + std::to_string(round));
+        }
+    }
+
+    void stream_matcher_tests() {
+        check_stream(Regex({ "ERROR \\d+" }), "lazy dfa", "/ERROR \\d+/");
+        check_stream(Regex({ "bar baz", "qux", "ERROR 7" }), "aho-corasick", "literal set");
+
+        // load_dfa uses the bytes in place, so they have to outlive the Regex
+        string saved = Regex({ "o+ (b|t)" }).save_dfa();
+        check_stream(Regex::load_dfa(saved), "dense dfa", "saved /o+ (b|t)/");
+    }
+}
+
+const TestGroup stream_matcher_group("stream matcher", stream_matcher_tests);